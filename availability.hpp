@@ -0,0 +1,288 @@
+#ifndef AVAILABILITY_HPP
+#define AVAILABILITY_HPP
+
+#include <cstdint>
+#include <vector>
+#include <algorithm>
+#include "queue.hpp"
+#include "slotkey.hpp"
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define BITSET_SSE2 1
+#endif
+using namespace std;
+
+// Rooms 1..ROOM_COUNT can be booked from OPEN_HOUR until CLOSE_HOUR; the
+// last bookable hour starts at CLOSE_HOUR - 1.
+const int ROOM_COUNT = 20;
+const int OPEN_HOUR = 8;
+const int CLOSE_HOUR = 17;
+
+const uint32_t OPEN_HOURS_MASK = ((1u << CLOSE_HOUR) - 1) & ~((1u << OPEN_HOUR) - 1);
+
+inline int lowestBit(uint64_t bits) {
+#ifdef _MSC_VER
+    unsigned long i;
+    _BitScanForward64(&i, bits);
+    return (int)i;
+#else
+    return __builtin_ctzll(bits);
+#endif
+}
+
+// Bit h is set in the result if hours h .. h + duration - 1 are all set in
+// free.
+inline uint32_t blockStarts(uint32_t free, int duration) {
+    uint32_t starts = free;
+    for (int k = 1; k < duration && starts != 0; k++)
+        starts &= free >> k;
+    return starts;
+}
+
+// Occupancy of one date as two bitmaps kept in step: hours booked per
+// room, and rooms booked per hour. The first answers "is this block of a
+// room free" with a mask test, the second "which rooms are free for this
+// block" with one OR per hour across 64 rooms at a time.
+class DayOccupancy {
+    private:
+    vector<uint32_t> roomHours;
+    vector<uint64_t> hourRooms[24];
+
+    public:
+    void set(int room, int hour) {
+        if ((size_t)room >= roomHours.size())
+            roomHours.resize(room + 1, 0);
+        roomHours[room] |= 1u << hour;
+
+        vector<uint64_t>& rooms = hourRooms[hour];
+        if ((size_t)(room >> 6) >= rooms.size())
+            rooms.resize((room >> 6) + 1, 0);
+        rooms[room >> 6] |= 1ULL << (room & 63);
+    }
+
+    void reset(int room, int hour) {
+        if ((size_t)room < roomHours.size())
+            roomHours[room] &= ~(1u << hour);
+        vector<uint64_t>& rooms = hourRooms[hour];
+        if ((size_t)(room >> 6) < rooms.size())
+            rooms[room >> 6] &= ~(1ULL << (room & 63));
+    }
+
+    uint32_t hoursOf(int room) {
+        return (size_t)room < roomHours.size() ? roomHours[room] : 0;
+    }
+
+    // Rooms word * 64 .. word * 64 + 63, limited to 1..rooms, that are free
+    // for all of startHour .. startHour + duration - 1.
+    uint64_t freeRoomWord(int word, int startHour, int duration, int rooms) {
+        uint64_t busy = 0;
+        for (int h = startHour; h < startHour + duration; h++) {
+            if ((size_t)word < hourRooms[h].size())
+                busy |= hourRooms[h][word];
+        }
+
+        uint64_t free = ~busy;
+        if (word == 0) free &= ~1ULL;
+        if (word == (rooms >> 6)) free &= (rooms & 63) == 63 ? ~0ULL : (2ULL << (rooms & 63)) - 1;
+        return free;
+    }
+
+    // Appends the free rooms for the block in ascending order.
+    void freeRooms(int startHour, int duration, int rooms, vector<int>& result) {
+        for (int word = 0; word <= (rooms >> 6); word++) {
+            uint64_t free = freeRoomWord(word, startHour, duration, rooms);
+            while (free != 0) {
+                result.push_back(word * 64 + lowestBit(free));
+                free &= free - 1;
+            }
+        }
+    }
+
+    // The lowest free room for the block, or 0.
+    int firstFreeRoom(int startHour, int duration, int rooms) {
+        for (int word = 0; word <= (rooms >> 6); word++) {
+            uint64_t free = freeRoomWord(word, startHour, duration, rooms);
+            if (free != 0) return word * 64 + lowestBit(free);
+        }
+        return 0;
+    }
+};
+
+// The occupancy of one week's dates, allocated the first time a date in
+// it is booked.
+class WeekOccupancy {
+    private:
+    DayOccupancy* days[7];
+
+    static int slot(int day) {
+        return (day + 5) % 7;
+    }
+
+    public:
+    WeekOccupancy() {
+        for (int i = 0; i < 7; i++)
+            days[i] = NULL;
+    }
+
+    ~WeekOccupancy() {
+        clear();
+    }
+
+    // NULL if nothing was ever booked on day.
+    DayOccupancy* find(int day) {
+        return days[slot(day)];
+    }
+
+    DayOccupancy* get(int day) {
+        DayOccupancy*& d = days[slot(day)];
+        if (d == NULL)
+            d = new DayOccupancy();
+        return d;
+    }
+
+    void set(const Booking& b) {
+        get(b.date)->set(b.room, b.hour);
+    }
+
+    void reset(const Booking& b) {
+        DayOccupancy* d = find(b.date);
+        if (d != NULL) d->reset(b.room, b.hour);
+    }
+
+    void clear() {
+        for (int i = 0; i < 7; i++) {
+            delete days[i];
+            days[i] = NULL;
+        }
+    }
+};
+
+// dst[i] |= src[i] and dst[i] &= src[i] over n words, two words per SSE2
+// instruction where available.
+inline void orWords(uint64_t* dst, const uint64_t* src, size_t n) {
+    size_t i = 0;
+#ifdef BITSET_SSE2
+    for (; i + 2 <= n; i += 2) {
+        __m128i a = _mm_loadu_si128((const __m128i*)(dst + i));
+        __m128i b = _mm_loadu_si128((const __m128i*)(src + i));
+        _mm_storeu_si128((__m128i*)(dst + i), _mm_or_si128(a, b));
+    }
+#endif
+    for (; i < n; i++)
+        dst[i] |= src[i];
+}
+
+inline void andWords(uint64_t* dst, const uint64_t* src, size_t n) {
+    size_t i = 0;
+#ifdef BITSET_SSE2
+    for (; i + 2 <= n; i += 2) {
+        __m128i a = _mm_loadu_si128((const __m128i*)(dst + i));
+        __m128i b = _mm_loadu_si128((const __m128i*)(src + i));
+        _mm_storeu_si128((__m128i*)(dst + i), _mm_and_si128(a, b));
+    }
+#endif
+    for (; i < n; i++)
+        dst[i] &= src[i];
+}
+
+// Occupancy by room across dates: for each room and hour a bitset over
+// day numbers. A weekly series is checked against all of its dates at once
+// by ORing the bitsets of its hours and ANDing with the series' date mask,
+// word by word over the date range.
+class RoomCalendar {
+    private:
+    struct RoomDays {
+        vector<uint64_t> hours[24];
+    };
+
+    vector<RoomDays*> rooms;
+
+    public:
+    ~RoomCalendar() {
+        clear();
+    }
+
+    void set(int room, int day, int hour) {
+        if ((size_t)room >= rooms.size())
+            rooms.resize(room + 1, NULL);
+        if (rooms[room] == NULL)
+            rooms[room] = new RoomDays();
+
+        vector<uint64_t>& days = rooms[room]->hours[hour];
+        if ((size_t)(day >> 6) >= days.size())
+            days.resize((day >> 6) + 1, 0);
+        days[day >> 6] |= 1ULL << (day & 63);
+    }
+
+    void reset(int room, int day, int hour) {
+        if ((size_t)room >= rooms.size() || rooms[room] == NULL) return;
+
+        vector<uint64_t>& days = rooms[room]->hours[hour];
+        if ((size_t)(day >> 6) < days.size())
+            days[day >> 6] &= ~(1ULL << (day & 63));
+    }
+
+    // Appends to conflicts the days fromDay, fromDay + step, ... up to
+    // toDay on which room has any of hours startHour .. startHour +
+    // duration - 1 booked.
+    void conflicts(int room, int startHour, int duration, int fromDay, int toDay, int step,
+                   vector<int>& conflicts) {
+        if ((size_t)room >= rooms.size() || rooms[room] == NULL || toDay < fromDay) return;
+
+        size_t first = fromDay >> 6;
+        size_t words = (toDay >> 6) - first + 1;
+        vector<uint64_t> dates(words, 0);
+        for (int day = fromDay; day <= toDay; day += step)
+            dates[(day >> 6) - first] |= 1ULL << (day & 63);
+
+        vector<uint64_t> busy(words, 0);
+        for (int h = startHour; h < startHour + duration; h++) {
+            const vector<uint64_t>& days = rooms[room]->hours[h];
+            if (days.size() > first)
+                orWords(busy.data(), days.data() + first, min(words, days.size() - first));
+        }
+        andWords(dates.data(), busy.data(), words);
+
+        for (size_t w = 0; w < words; w++) {
+            uint64_t bits = dates[w];
+            while (bits != 0) {
+                conflicts.push_back((int)((first + w) * 64) + lowestBit(bits));
+                bits &= bits - 1;
+            }
+        }
+    }
+
+    size_t memoryUsage() {
+        size_t total = sizeof(*this) + rooms.capacity() * sizeof(RoomDays*);
+        for (size_t r = 0; r < rooms.size(); r++) {
+            if (rooms[r] == NULL) continue;
+            total += sizeof(RoomDays);
+            for (int h = 0; h < 24; h++)
+                total += rooms[r]->hours[h].capacity() * sizeof(uint64_t);
+        }
+        return total;
+    }
+
+    // Clears fromDay .. toDay for every room and hour.
+    void clearDays(int fromDay, int toDay) {
+        for (size_t r = 0; r < rooms.size(); r++) {
+            if (rooms[r] == NULL) continue;
+            for (int h = 0; h < 24; h++) {
+                vector<uint64_t>& days = rooms[r]->hours[h];
+                for (int day = fromDay; day <= toDay && (size_t)(day >> 6) < days.size(); day++)
+                    days[day >> 6] &= ~(1ULL << (day & 63));
+            }
+        }
+    }
+
+    void clear() {
+        for (size_t i = 0; i < rooms.size(); i++)
+            delete rooms[i];
+        rooms.clear();
+    }
+};
+
+#endif
@@ -0,0 +1,404 @@
+// Benchmarks for the booking engine on a synthetic timetable. Each phase
+// is timed on its own and reported as one row, so runs of two versions
+// with the same options can be compared line by line.
+//
+// The timetable covers --days consecutive days from 2026-01-05 and --rooms
+// rooms; each open hour of a room is booked with probability --fill,
+// weighted towards low-numbered rooms by --skew (a Zipf exponent, 0 for
+// uniform). Lecturers are picked with the same skew. The file is written in
+// slot order or, with --order random, shuffled.
+//
+// The benchmark works in its own directory, --dir, and replaces the
+// bookings files there.
+//
+//   bench [--days 180] [--rooms 20] [--lecturers 200] [--fill 0.6] [--skew 0]
+//         [--order sorted|random] [--ops 100000] [--seed 1] [--format csv|json]
+//         [--dir bench.tmp]
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <random>
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstdio>
+#ifdef _WIN32
+#include <direct.h>
+#define chdir _chdir
+#else
+#include <unistd.h>
+#endif
+#include "booking.hpp"
+using namespace std;
+
+struct BenchOptions {
+    int days;
+    int rooms;
+    int lecturers;
+    double fill;
+    double skew;
+    bool randomOrder;
+    int ops;
+    unsigned seed;
+    string format;
+    string dir;
+};
+
+// matched counts the operations that found or changed something, where
+// that can differ from ops: search hits, blocks booked, promotions, deletes.
+struct BenchResult {
+    string name;
+    long long ops;
+    long long matched;
+    double seconds;
+};
+
+class Stopwatch {
+    private:
+    chrono::steady_clock::time_point start;
+
+    public:
+    Stopwatch() {
+        start = chrono::steady_clock::now();
+    }
+
+    double seconds() {
+        return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    }
+};
+
+// Samples 0 .. n-1 with weight 1 / (i + 1)^skew.
+class ZipfPicker {
+    private:
+    vector<double> cumulative;
+
+    public:
+    ZipfPicker(int n, double skew) {
+        double total = 0;
+        for (int i = 0; i < n; i++) {
+            total += 1.0 / pow(i + 1, skew);
+            cumulative.push_back(total);
+        }
+        for (int i = 0; i < n; i++)
+            cumulative[i] /= total;
+    }
+
+    double weight(int i) {
+        return cumulative[i] - (i > 0 ? cumulative[i - 1] : 0);
+    }
+
+    int pick(mt19937& rng) {
+        double u = uniform_real_distribution<double>(0, 1)(rng);
+        return (int)min(cumulative.size() - 1,
+                        (size_t)(lower_bound(cumulative.begin(), cumulative.end(), u) - cumulative.begin()));
+    }
+};
+
+int FirstDay() {
+    int day = 0;
+    parseDate("260105", day);
+    return day;
+}
+
+// Returns the timetable in slot order.
+void GenerateTimetable(const BenchOptions& options, mt19937& rng, vector<Booking>& rows) {
+    ZipfPicker rooms(options.rooms, options.skew);
+    ZipfPicker lecturers(options.lecturers, options.skew);
+    uniform_real_distribution<double> coin(0, 1);
+
+    vector<int> lecturerIds, courseIds;
+    for (int i = 0; i < options.lecturers; i++) {
+        lecturerIds.push_back(Names().intern("Lecturer" + to_string(i + 1)));
+        courseIds.push_back(Names().intern("C" + to_string(100 + i)));
+    }
+
+    int first = FirstDay();
+    for (int day = first; day < first + options.days; day++) {
+        for (int room = 1; room <= options.rooms; room++) {
+            double p = min(1.0, options.fill * options.rooms * rooms.weight(room - 1));
+            for (int hour = OPEN_HOUR; hour < CLOSE_HOUR; hour++) {
+                if (coin(rng) >= p) continue;
+
+                int who = lecturers.pick(rng);
+                Booking b;
+                b.date = day;
+                b.hour = hour;
+                b.room = room;
+                b.lecturer = lecturerIds[who];
+                b.course = courseIds[who];
+                rows.push_back(b);
+            }
+        }
+    }
+}
+
+void RemoveBookingFiles() {
+    remove(BOOKINGS_FILE);
+    remove(SNAPSHOT_BIN_FILE);
+    remove(JOURNAL_FILE);
+    remove(JOURNAL_OLD_FILE);
+    remove(ARCHIVE_MANIFEST);
+}
+
+// Closes the journal and empties the store, as the programs do on exit.
+void Reset(BookingStore& store) {
+    journal.close();
+    snapshotView.close();
+    store.clear();
+}
+
+Booking RandomSlot(const BenchOptions& options, mt19937& rng) {
+    Booking b;
+    b.date = FirstDay() + rng() % options.days;
+    b.room = 1 + rng() % options.rooms;
+    b.hour = OPEN_HOUR + rng() % (CLOSE_HOUR - OPEN_HOUR);
+    static int lecturer = Names().intern("Bench");
+    static int course = Names().intern("B100");
+    b.lecturer = lecturer;
+    b.course = course;
+    return b;
+}
+
+void RunBenchmarks(const BenchOptions& options, vector<BenchResult>& results, size_t& bookings) {
+    mt19937 rng(options.seed);
+    vector<Booking> rows;
+    GenerateTimetable(options, rng, rows);
+    if (options.randomOrder)
+        shuffle(rows.begin(), rows.end(), rng);
+    bookings = rows.size();
+
+    BookingStore store;
+    {
+        Stopwatch t;
+        for (size_t i = 0; i < rows.size(); i++)
+            Insert(store, rows[i]);
+        results.push_back({"insert", (long long)rows.size(), (long long)rows.size(), t.seconds()});
+    }
+    store.clear();
+
+    RemoveBookingFiles();
+    string text;
+    for (size_t i = 0; i < rows.size(); i++)
+        appendCsvBooking(text, rows[i]);
+    writeFileAtomic(BOOKINGS_FILE, text);
+
+    ConvertToBinary(BOOKINGS_FILE, SNAPSHOT_BIN_FILE);
+    {
+        Stopwatch t;
+        LoadFromFile(store);
+        results.push_back({"load_binary", (long long)rows.size(), (long long)rows.size(), t.seconds()});
+    }
+    {
+        Stopwatch t;
+        Materialize(store);
+        results.push_back({"materialize", (long long)rows.size(), (long long)rows.size(), t.seconds()});
+    }
+    Reset(store);
+    remove(SNAPSHOT_BIN_FILE);
+    remove(JOURNAL_FILE);
+
+    {
+        Stopwatch t;
+        LoadFromFile(store);
+        results.push_back({"load_text", (long long)rows.size(), (long long)rows.size(), t.seconds()});
+    }
+    {
+        Stopwatch t;
+        RewriteFile(store);
+        results.push_back({"rewrite", (long long)store.count(), (long long)store.count(), t.seconds()});
+    }
+
+    {
+        long long hits = 0;
+        Booking found;
+        Stopwatch t;
+        for (int i = 0; i < options.ops; i++) {
+            Booking b = RandomSlot(options, rng);
+            hits += FindBooking(store, makeSlotKey(b.date, b.room, b.hour), found);
+        }
+        results.push_back({"search", options.ops, hits, t.seconds()});
+    }
+
+    {
+        long long booked = 0;
+        Stopwatch t;
+        for (int i = 0; i < options.ops; i++) {
+            Booking b = RandomSlot(options, rng);
+            int duration = 1 + rng() % 3;
+            if (validDuration(b.hour, duration))
+                booked += BookSlots(store, b, duration);
+        }
+        results.push_back({"book_block", options.ops, booked, t.seconds()});
+    }
+    {
+        Stopwatch t;
+        CommitChanges(store);
+        results.push_back({"commit", 1, 1, t.seconds()});
+    }
+
+    // Queue a booking on some taken slots, then cancel those slots so the
+    // waiting booking is promoted.
+    vector<Booking> taken;
+    CollectAll(store, taken);
+    shuffle(taken.begin(), taken.end(), rng);
+    taken.resize(min(taken.size(), (size_t)options.ops));
+    {
+        Booking waiting = RandomSlot(options, rng);
+        Stopwatch t;
+        for (size_t i = 0; i < taken.size(); i++) {
+            waiting.date = taken[i].date;
+            waiting.hour = taken[i].hour;
+            waiting.room = taken[i].room;
+            JoinWaitlist(store, waiting, 1);
+        }
+        results.push_back({"waitlist_join", (long long)taken.size(), (long long)taken.size(), t.seconds()});
+    }
+    {
+        vector<Booking> removed, promoted;
+        Stopwatch t;
+        for (size_t i = 0; i < taken.size(); i++)
+            CancelSlots(store, taken[i].date, taken[i].room, taken[i].hour, 1, removed, promoted);
+        CommitChanges(store);
+        results.push_back({"cancel_promote", (long long)taken.size(), (long long)promoted.size(), t.seconds()});
+    }
+
+    {
+        vector<Booking> all;
+        Stopwatch t;
+        CollectAll(store, all);
+        results.push_back({"report_all", (long long)all.size(), (long long)all.size(), t.seconds()});
+    }
+    {
+        long long rowsSeen = 0;
+        Stopwatch t;
+        int first = FirstDay();
+        for (int day = first; day < first + options.days; day++) {
+            VisitDate(store, day, [&](const Booking&) {
+                rowsSeen++;
+                return true;
+            });
+        }
+        results.push_back({"report_date", rowsSeen, rowsSeen, t.seconds()});
+    }
+    {
+        vector<Booking> part;
+        long long rowsSeen = 0;
+        Stopwatch t;
+        for (int room = 1; room <= options.rooms; room++) {
+            part.clear();
+            CollectRoom(store, room, 0, LAST_DAY, part);
+            rowsSeen += part.size();
+        }
+        results.push_back({"report_room", rowsSeen, rowsSeen, t.seconds()});
+    }
+
+    {
+        long long deleted = 0;
+        Stopwatch t;
+        for (size_t i = 0; i < taken.size(); i++)
+            deleted += Delete(store, makeSlotKey(taken[i].date, taken[i].room, taken[i].hour));
+        results.push_back({"delete", (long long)taken.size(), deleted, t.seconds()});
+    }
+
+    Reset(store);
+}
+
+void PrintCsv(const BenchOptions& options, size_t bookings, const vector<BenchResult>& results) {
+    cout << "benchmark,ops,matched,seconds,ns_per_op,bookings,days,rooms,lecturers,skew,order\n";
+    for (size_t i = 0; i < results.size(); i++) {
+        const BenchResult& r = results[i];
+        cout << r.name << "," << r.ops << "," << r.matched << "," << fixed << setprecision(6) << r.seconds << ","
+             << setprecision(1) << (r.ops > 0 ? r.seconds * 1e9 / r.ops : 0) << ","
+             << bookings << "," << options.days << "," << options.rooms << ","
+             << options.lecturers << "," << setprecision(2) << options.skew << ","
+             << (options.randomOrder ? "random" : "sorted") << "\n";
+    }
+}
+
+void PrintJson(const BenchOptions& options, size_t bookings, const vector<BenchResult>& results) {
+    cout << fixed << "{\"config\":{\"bookings\":" << bookings << ",\"days\":" << options.days
+         << ",\"rooms\":" << options.rooms << ",\"lecturers\":" << options.lecturers
+         << ",\"fill\":" << setprecision(2) << options.fill << ",\"skew\":" << options.skew
+         << ",\"order\":\"" << (options.randomOrder ? "random" : "sorted")
+         << "\",\"ops\":" << options.ops << ",\"seed\":" << options.seed << "},\"results\":[";
+    for (size_t i = 0; i < results.size(); i++) {
+        const BenchResult& r = results[i];
+        cout << (i > 0 ? "," : "") << "\n  {\"benchmark\":\"" << r.name << "\",\"ops\":" << r.ops
+             << ",\"matched\":" << r.matched << ",\"seconds\":" << setprecision(6) << r.seconds << ",\"ns_per_op\":" << setprecision(1)
+             << (r.ops > 0 ? r.seconds * 1e9 / r.ops : 0) << "}";
+    }
+    cout << "\n]}\n";
+}
+
+int Usage(const char* program) {
+    cerr << "Usage: " << program << " [--days 180] [--rooms 20] [--lecturers 200] [--fill 0.6]\n"
+         << "       [--skew 0] [--order sorted|random] [--ops 100000] [--seed 1]\n"
+         << "       [--format csv|json] [--dir bench.tmp]\n";
+    return 1;
+}
+
+int main(int argc, char* argv[]) {
+    BenchOptions options;
+    options.days = 180;
+    options.rooms = ROOM_COUNT;
+    options.lecturers = 200;
+    options.fill = 0.6;
+    options.skew = 0;
+    options.randomOrder = false;
+    options.ops = 100000;
+    options.seed = 1;
+    options.format = "csv";
+    options.dir = "bench.tmp";
+
+    // An unknown option, a bad value or a missing one would otherwise run,
+    // and report, the default workload.
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if (i + 1 >= argc)
+            return Usage(argv[0]);
+
+        string value = argv[++i];
+        bool valid = true;
+        if (arg == "--days") options.days = atoi(value.c_str());
+        else if (arg == "--rooms") options.rooms = atoi(value.c_str());
+        else if (arg == "--lecturers") options.lecturers = atoi(value.c_str());
+        else if (arg == "--fill") options.fill = atof(value.c_str());
+        else if (arg == "--skew") options.skew = atof(value.c_str());
+        else if (arg == "--order") {
+            options.randomOrder = value == "random";
+            valid = value == "random" || value == "sorted";
+        } else if (arg == "--ops") options.ops = atoi(value.c_str());
+        else if (arg == "--seed") options.seed = (unsigned)atoi(value.c_str());
+        else if (arg == "--format") {
+            options.format = value;
+            valid = value == "csv" || value == "json";
+        } else if (arg == "--dir") options.dir = value;
+        else valid = false;
+
+        if (!valid)
+            return Usage(argv[0]);
+    }
+    if (options.days < 1 || options.rooms < 1 || options.rooms > 65535 || options.lecturers < 1) {
+        cerr << "--days, --rooms (up to 65535) and --lecturers must be positive\n";
+        return 1;
+    }
+
+    mkdir(options.dir.c_str(), 0755);
+    if (chdir(options.dir.c_str()) != 0) {
+        cerr << options.dir << ": cannot use as benchmark directory\n";
+        return 1;
+    }
+
+    vector<BenchResult> results;
+    size_t bookings = 0;
+    RunBenchmarks(options, results, bookings);
+    RemoveBookingFiles();
+
+    if (options.format == "json")
+        PrintJson(options, bookings, results);
+    else
+        PrintCsv(options, bookings, results);
+    return 0;
+}
@@ -0,0 +1,517 @@
+#ifndef BOOKING_HPP
+#define BOOKING_HPP
+
+#include <iostream>
+#include <string>
+#include <fstream>
+#include <vector>
+#include "queue.hpp"
+#include "stack.hpp"
+#include "slotkey.hpp"
+#include "tree.hpp"
+#include "journal.hpp"
+#include "waitlist.hpp"
+#include "loader.hpp"
+#include "snapshot.hpp"
+#include "store.hpp"
+#include "reportcache.hpp"
+using namespace std;
+
+// The booking engine shared by the interactive menu, batch mode and the
+// server: global state (journal, mapped snapshot), persistence and the
+// book/cancel operations over a BookingStore. Every program includes it
+// from exactly one translation unit.
+
+bool validDate(string d) {
+    int day;
+    return parseDate(d, day);
+}
+
+bool validHour(int h) {
+    return (h >= OPEN_HOUR && h < CLOSE_HOUR);
+}
+
+bool validDuration(int startHour, int duration) {
+    return duration >= 1 && startHour + duration <= CLOSE_HOUR;
+}
+
+// The last day of an open-ended room schedule (see VisitRoom and
+// CollectRoom in store.hpp).
+const int LAST_DAY = 1 << 30;
+
+void SaveToFile(TreeNode* tree, ostream& out) {
+    ReportWriter report(out, REPORT_CSV);
+    for (TreeNode* node = First(tree); node != NULL; node = Successor(node))
+        report.add(node->info);
+}
+
+Journal journal;
+
+// When bookings.bin is the snapshot, it stays mapped and answers searches
+// and date reports directly until something needs the tree.
+SnapshotView snapshotView;
+bool binarySnapshot = false;
+
+// Builds the shards from the mapped snapshot, the first time they are
+// needed.
+void Materialize(BookingStore& store) {
+    if (!snapshotView.isOpen()) return;
+
+    vector<Booking> rows;
+    snapshotView.copyTo(rows);
+    snapshotView.close();
+    BuildStore(store, rows);
+}
+
+// The snapshot holds every shard that is not archived.
+string SnapshotText(BookingStore& store) {
+    Materialize(store);
+    if (binarySnapshot) {
+        vector<Booking> rows;
+        rows.reserve(store.count());
+        for (size_t i = 0; i < store.size(); i++) {
+            Shard* shard = store.at(i);
+            if (shard->archived) continue;
+            for (TreeNode* node = First(shard->index.root); node != NULL; node = Successor(node))
+                rows.push_back(node->info);
+        }
+        return EncodeSnapshot(rows);
+    }
+
+    string text;
+    for (size_t i = 0; i < store.size(); i++) {
+        if (store.at(i)->archived) continue;
+        for (TreeNode* node = First(store.at(i)->index.root); node != NULL; node = Successor(node))
+            appendCsvBooking(text, node->info);
+    }
+    return text;
+}
+
+// A date's bookings are one contiguous range of its shard's primary tree,
+// or of the mapped snapshot while it is still in use. They go to visit in
+// slot order until it returns false.
+template <class Visit>
+bool VisitDate(BookingStore& store, int day, Visit visit) {
+    SlotKey end = makeSlotKey(day + 1, 0, 0);
+
+    if (snapshotView.isOpen() && !IsArchived(store, day)) {
+        for (size_t i = snapshotView.lowerBound(makeSlotKey(day, 0, 0));
+             i < snapshotView.size() && snapshotView.keyAt(i) < end; i++) {
+            if (!visit(snapshotView.bookingAt(i))) return false;
+        }
+        return true;
+    }
+
+    Shard* shard = ReadableShard(store, day);
+    return shard == NULL || VisitRange(DateRange(shard->index, day, day), visit);
+}
+
+ReportCache reportCache;
+
+// A date's bookings in slot order, from the report cache while the date
+// has not changed since they were cached.
+void DateSchedule(BookingStore& store, int day, vector<Booking>& rows) {
+    if (reportCache.lookup(store, QUERY_DATE, day, day, day, rows)) return;
+
+    uint64_t epoch = store.currentEpoch();
+    size_t first = rows.size();
+    VisitDate(store, day, [&](const Booking& b) {
+        rows.push_back(b);
+        return true;
+    });
+    reportCache.store(QUERY_DATE, day, day, day, epoch, vector<Booking>(rows.begin() + first, rows.end()));
+}
+
+// A room's bookings between fromDay and toDay in date order, from the
+// report cache while the room has not changed since they were cached.
+void RoomSchedule(BookingStore& store, int room, int fromDay, int toDay, vector<Booking>& rows) {
+    if (reportCache.lookup(store, QUERY_ROOM, room, fromDay, toDay, rows)) return;
+
+    Materialize(store);
+    uint64_t epoch = store.currentEpoch();
+    size_t first = rows.size();
+    CollectRoom(store, room, fromDay, toDay, rows);
+    reportCache.store(QUERY_ROOM, room, fromDay, toDay, epoch, vector<Booking>(rows.begin() + first, rows.end()));
+}
+
+bool FindBooking(BookingStore& store, SlotKey key, Booking& result) {
+    STAT_TIMER(search);
+    if (snapshotView.isOpen() && !IsArchived(store, slotDay(key)))
+        return snapshotView.find(key, result);
+    return Search(store, key, result);
+}
+
+// The records a fresh journal starts with (see journal.hpp): R, then every
+// waiting booking, each slot's queue front to back.
+string WaitlistText(BookingStore& store) {
+    string text = "R\n";
+    for (size_t i = 0; i < store.size(); i++) {
+        store.at(i)->waitlists.forEach([&](SlotKey, WaitlistQueue* queue) {
+            queue->forEach([&](const Booking& b) {
+                text += "W,";
+                appendCsvBooking(text, b);
+            });
+        });
+    }
+    return text;
+}
+
+// Writes a full snapshot synchronously and starts a journal holding only
+// the waitlists.
+void RewriteFile(BookingStore& store) {
+    STAT_TIMER(rewrite);
+    journal.compactNow(SnapshotText(store), WaitlistText(store));
+}
+
+// Hands the changes logged since the last call to the journal and returns
+// the commit number to pass to journal.waitDurable. The snapshot is only
+// rewritten, in the background, once the journal has grown past its
+// compaction threshold; no other thread may be changing the store.
+uint64_t SubmitChanges(BookingStore& store) {
+    uint64_t ticket = journal.submit();
+    if (journal.needsCompaction())
+        journal.compact(SnapshotText(store), WaitlistText(store));
+    return ticket;
+}
+
+// Makes the changes logged since the last call durable, as far as the
+// journal's durability mode promises: one append and one fsync, possibly
+// shared with other commits or left to the writer thread.
+void CommitChanges(BookingStore& store) {
+    journal.waitDurable(SubmitChanges(store));
+}
+
+// Parses "date,hour,room[,lecturer,course]".
+bool parseBooking(const string& line, Booking& b, bool keyOnly) {
+    size_t p1 = line.find(',');
+    if (p1 == string::npos) return false;
+    size_t p2 = line.find(',', p1 + 1);
+    if (p2 == string::npos) return false;
+    size_t p3 = line.find(',', p2 + 1);
+    if (p3 == string::npos && !keyOnly) return false;
+
+    int hour;
+    try {
+        hour = stoi(line.substr(p1 + 1, p2 - p1 - 1));
+    } catch (...) {
+        return false;
+    }
+    string date = line.substr(0, p1);
+    string room = line.substr(p2 + 1, p3 == string::npos ? string::npos : p3 - p2 - 1);
+    if (keyOnly) return makeBooking(date, hour, room, "", "", b);
+
+    size_t p4 = line.find(',', p3 + 1);
+    if (p4 == string::npos) return false;
+    return makeBooking(date, hour, room, line.substr(p3 + 1, p4 - p3 - 1), line.substr(p4 + 1), b);
+}
+
+// Applies every complete record of a journal file to the store and its
+// waitlists. A torn last line (no trailing newline), a malformed line or an
+// unknown record type is skipped. Returns the number of records applied.
+int ReplayJournal(const char* path, BookingStore& store) {
+    ifstream in(path, ios::binary);
+    if (!in) return 0;
+
+    string data((istreambuf_iterator<char>(in)), istreambuf_iterator<char>());
+    int count = 0;
+    size_t start = 0, end;
+
+    while ((end = data.find('\n', start)) != string::npos) {
+        string line = data.substr(start, end - start);
+        start = end + 1;
+
+        if (line == "R") {
+            store.clearWaitlists();
+            count++;
+            continue;
+        }
+        if (line.size() < 2 || line[1] != ',') continue;
+        char op = line[0];
+        if (op != 'I' && op != 'P' && op != 'D' && op != 'W') continue;
+
+        Booking b;
+        SlotKey key = 0;
+        if (!parseBooking(line.substr(2), b, op == 'D') || !makeKey(b, key)) continue;
+
+        // R and W only touch waitlists, so a journal holding nothing else
+        // (as every compaction leaves it) keeps a mapped snapshot mapped.
+        if (op != 'W') Materialize(store);
+
+        if (op == 'D') {
+            Delete(store, key);
+        } else if (op == 'W') {
+            Shard* shard = WritableShard(store, b.date);
+            if (shard != NULL) shard->waitlists.get(key)->enQueue(b);
+        } else if (op == 'P') {
+            Shard* shard = store.find(weekOf(b.date));
+            Booking first;
+            if (shard != NULL) shard->waitlists.dequeue(key, first);
+            Insert(store, b);
+        } else {
+            Insert(store, b);
+        }
+        count++;
+    }
+    return count;
+}
+
+// Registers the archived weeks, loads bookings.bin if it exists, otherwise
+// bookings.txt, then replays the journal. Returns false if the binary
+// snapshot is unusable; starting anyway would overwrite it on the next
+// compaction.
+bool LoadFromFile(BookingStore& store) {
+    STAT_TIMER(load);
+    store.loadManifest();
+    binarySnapshot = Journal::fileExists(SNAPSHOT_BIN_FILE);
+
+    if (binarySnapshot) {
+        string error;
+        if (!snapshotView.open(SNAPSHOT_BIN_FILE, error)) {
+            cerr << SNAPSHOT_BIN_FILE << ": " << error << "\n";
+            return false;
+        }
+        journal.snapshotPath = SNAPSHOT_BIN_FILE;
+    } else {
+        vector<Booking> rows;
+        vector<LoadError> errors;
+        BulkLoad(BOOKINGS_FILE, rows, errors);
+        for (size_t i = 0; i < errors.size(); i++)
+            cerr << BOOKINGS_FILE << ":" << errors[i].line << ": " << errors[i].message << "\n";
+        BuildStore(store, rows);
+    }
+
+    bool interrupted = Journal::fileExists(JOURNAL_OLD_FILE);
+    int replayed = ReplayJournal(JOURNAL_OLD_FILE, store);
+    replayed += ReplayJournal(JOURNAL_FILE, store);
+
+    journal.open(replayed);
+    if (interrupted)
+        RewriteFile(store);
+    return true;
+}
+
+// Converts a bookings.txt-style file into a binary snapshot.
+bool ConvertToBinary(const char* csvPath, const char* binPath) {
+    vector<Booking> rows;
+    vector<LoadError> errors;
+    BulkLoad(csvPath, rows, errors);
+    for (size_t i = 0; i < errors.size(); i++)
+        cerr << csvPath << ":" << errors[i].line << ": " << errors[i].message << "\n";
+
+    return writeFileAtomic(binPath, EncodeSnapshot(rows));
+}
+
+// Converts a binary snapshot back into bookings.txt format.
+bool ConvertToCsv(const char* binPath, const char* csvPath) {
+    SnapshotView view;
+    string error;
+    if (!view.open(binPath, error)) {
+        cerr << binPath << ": " << error << "\n";
+        return false;
+    }
+
+    string text;
+    for (size_t i = 0; i < view.size(); i++)
+        appendCsvBooking(text, view.bookingAt(i));
+    return writeFileAtomic(csvPath, text);
+}
+
+// Books duration hours from b.hour, all or nothing, and logs them to the
+// journal. The caller makes the change durable with CommitChanges.
+bool BookSlots(BookingStore& store, const Booking& b, int duration) {
+    Materialize(store);
+    if (!InsertBlock(store, b, duration))
+        return false;
+
+    for (int i = 0; i < duration; i++) {
+        Booking temp = b;
+        temp.hour = b.hour + i;
+        journal.logInsert(temp);
+    }
+    return true;
+}
+
+// Queues b for each hour of the block and logs it to the journal, each
+// slot's records in queue order. Archived weeks take no waitlists. Threads
+// holding the engine lock shared may join at once provided b's week already
+// has a shard, as it does when the block is partly booked; creating one
+// changes the store.
+bool JoinWaitlist(BookingStore& store, const Booking& b, int duration) {
+    Shard* shard = WritableShard(store, b.date);
+    if (shard == NULL) return false;
+
+    for (int i = 0; i < duration; i++) {
+        Booking temp = b;
+        temp.hour = b.hour + i;
+        SlotKey key = 0;
+        if (makeKey(temp, key)) {
+            WaitlistQueue* queue = shard->waitlists.get(key);
+            queue->enQueue(temp, [](const Booking& joined) { journal.logWaitlist(joined); });
+            STAT_ADD(waitlistJoins, 1);
+            STAT_MAX(longestWaitlist, (uint64_t)queue->getSize());
+        }
+    }
+    return true;
+}
+
+// Books b's block every week from b.date through lastDay as one series.
+// conflicts receives every date on which the block is already taken, found
+// with one pass over the room's calendar. Without waitlist nothing is booked
+// unless all dates are free; with it the free dates are booked and b is
+// queued on the taken ones. booked receives the booked dates. Returns false,
+// changing nothing, if any date of the series is in an archived week.
+bool BookSeries(BookingStore& store, const Booking& b, int duration, int lastDay, bool waitlist,
+                vector<int>& booked, vector<int>& conflicts) {
+    Materialize(store);
+    for (int day = b.date; day <= lastDay; day += 7) {
+        if (IsArchived(store, day)) return false;
+    }
+
+    store.calendar.conflicts(b.room, b.hour, duration, b.date, lastDay, 7, conflicts);
+    if (!conflicts.empty() && !waitlist) return true;
+
+    size_t next = 0;
+    for (int day = b.date; day <= lastDay; day += 7) {
+        Booking occurrence = b;
+        occurrence.date = day;
+        if (next < conflicts.size() && conflicts[next] == day) {
+            JoinWaitlist(store, occurrence, duration);
+            next++;
+        } else if (BookSlots(store, occurrence, duration)) {
+            booked.push_back(day);
+        }
+    }
+    return true;
+}
+
+// The waitlists of day's shard, or NULL if it has none.
+WaitlistRegistry* WaitlistsFor(BookingStore& store, int day) {
+    Shard* shard = store.find(weekOf(day));
+    return shard != NULL ? &shard->waitlists : NULL;
+}
+
+// Cancels the booked hours of the block, logging each one, and hands every
+// freed slot to the first booking waiting for it. removed and promoted
+// receive the cancelled and promoted bookings in hour order.
+int CancelSlots(BookingStore& store, int day, int room, int startHour, int duration,
+                vector<Booking>& removed, vector<Booking>& promoted) {
+    Materialize(store);
+    Shard* shard = store.find(weekOf(day));
+    if (shard == NULL || shard->archived) return 0;
+
+    size_t first = removed.size();
+    DeleteBlock(store, day, room, startHour, duration, removed);
+
+    for (size_t i = first; i < removed.size(); i++) {
+        journal.logDelete(removed[i]);
+
+        Booking nextBooking;
+        STAT_CLOCK(promoteStart);
+        if (shard->waitlists.dequeue(makeSlotKey(day, room, removed[i].hour), nextBooking)) {
+            Insert(store, nextBooking);
+            journal.logPromote(nextBooking);
+            promoted.push_back(nextBooking);
+            STAT_ADD(promotions, 1);
+            STAT_SINCE(promote, promoteStart);
+        }
+    }
+    return (int)(removed.size() - first);
+}
+
+// Archives every week that ends before day and has no one waiting. The
+// archive files and manifest are written first and the main snapshot
+// rewritten without those weeks afterwards, so a crash in between only
+// leaves rows in the snapshot that BuildStore ignores. Returns the number
+// of weeks archived, or -1 if an archive file could not be written.
+int ArchiveBefore(BookingStore& store, int day) {
+    Materialize(store);
+    RewriteFile(store);
+
+    vector<Shard*> old;
+    for (size_t i = 0; i < store.size(); i++) {
+        Shard* shard = store.at(i);
+        if (!shard->archived && lastDayOfWeek(shard->week) < day &&
+            shard->index.count > 0 && shard->waitlists.size() == 0)
+            old.push_back(shard);
+    }
+    if (old.empty()) return 0;
+
+    for (size_t i = 0; i < old.size(); i++) {
+        if (!WriteArchive(old[i])) return -1;
+    }
+    for (size_t i = 0; i < old.size(); i++)
+        old[i]->archived = true;
+    if (!store.saveManifest()) {
+        for (size_t i = 0; i < old.size(); i++)
+            old[i]->archived = false;
+        return -1;
+    }
+
+    for (size_t i = 0; i < old.size(); i++) {
+        UnloadShard(old[i]);
+        store.calendar.clearDays(lastDayOfWeek(old[i]->week) - 6, lastDayOfWeek(old[i]->week));
+    }
+    RewriteFile(store);
+    return (int)old.size();
+}
+
+// The Stats() counters and histograms followed by the current shape of
+// the store: shards, tree heights and node counts, and memory per
+// structure. Archived shards that are not loaded count as empty.
+void CollectStats(BookingStore& store, vector<StatValue>& values) {
+    EngineStats& stats = Stats();
+    values.push_back({"stats_enabled", STATS_ENABLED ? 1u : 0u});
+    appendHistogram(values, "insert", stats.insert);
+    appendHistogram(values, "search", stats.search);
+    appendHistogram(values, "delete", stats.remove);
+    appendHistogram(values, "load", stats.load);
+    appendHistogram(values, "rewrite", stats.rewrite);
+    appendHistogram(values, "commit", stats.commit);
+    appendHistogram(values, "compaction", stats.compaction);
+    appendHistogram(values, "promote", stats.promote);
+    values.push_back({"tree_lookups", stats.treeLookups.load()});
+    values.push_back({"tree_steps", stats.treeSteps.load()});
+    values.push_back({"waitlist_joins", stats.waitlistJoins.load()});
+    values.push_back({"promotions", stats.promotions.load()});
+    values.push_back({"longest_waitlist", stats.longestWaitlist.load()});
+
+    ReportCacheStats cache = reportCache.stats();
+    values.push_back({"report_cache_hits", cache.hits});
+    values.push_back({"report_cache_misses", cache.misses});
+    values.push_back({"report_cache_stale", cache.stale});
+    values.push_back({"report_cache_evictions", cache.evictions});
+    values.push_back({"report_cache_entries", cache.entries});
+    values.push_back({"report_cache_rows", cache.rows});
+    values.push_back({"report_cache_bytes", cache.bytes});
+
+    uint64_t loaded = 0, archived = 0, height = 0, roomHeight = 0;
+    for (size_t i = 0; i < store.size(); i++) {
+        Shard* shard = store.at(i);
+        if (shard->archived) archived++;
+        if (!shard->loaded) continue;
+
+        loaded++;
+        height = max(height, (uint64_t)Height(shard->index.root));
+        roomHeight = max(roomHeight, (uint64_t)Height(shard->index.byRoom));
+    }
+    values.push_back({"shards", store.size()});
+    values.push_back({"shards_loaded", loaded});
+    values.push_back({"shards_archived", archived});
+    values.push_back({"bookings", (uint64_t)store.count()});
+    values.push_back({"tree_height", height});
+    values.push_back({"room_tree_height", roomHeight});
+
+    NodePool<TreeNode>::Stats treeNodes = NodePool<TreeNode>::instance().stats();
+    NodePool<RoomNode>::Stats roomNodes = NodePool<RoomNode>::instance().stats();
+    values.push_back({"tree_nodes", treeNodes.live});
+    values.push_back({"tree_bytes", treeNodes.bytesReserved});
+    values.push_back({"room_tree_nodes", roomNodes.live});
+    values.push_back({"room_tree_bytes", roomNodes.bytesReserved});
+    values.push_back({"waitlists", store.waitlistCount()});
+    values.push_back({"waitlist_bytes", store.waitlistMemory()});
+    values.push_back({"calendar_bytes", store.calendar.memoryUsage()});
+    values.push_back({"names", Names().size()});
+    values.push_back({"names_bytes", Names().memoryUsage()});
+}
+
+#endif
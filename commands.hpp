@@ -0,0 +1,425 @@
+#ifndef COMMANDS_HPP
+#define COMMANDS_HPP
+
+#include <string>
+#include <vector>
+#include "queue.hpp"
+#include "slotkey.hpp"
+#include "tree.hpp"
+#include "booking.hpp"
+#include "report.hpp"
+using namespace std;
+
+// Text commands for batch mode, one per line, fields separated by commas:
+//   book,DATE,HOUR,DURATION,ROOM,LECTURER,COURSE[,waitlist]
+//   series,DATE,HOUR,DURATION,ROOM,LECTURER,COURSE,UNTIL[,waitlist]
+//                        the same block every week from DATE through UNTIL
+//   cancel,DATE,HOUR,DURATION,ROOM
+//   search,DATE,HOUR,ROOM
+//   waitlist,DATE,HOUR,ROOM
+//   report,all | report,date,DATE | report,room,ROOM[,FROM,TO] |
+//   report,lecturer,NAME | report,course,NAME
+//   free,DATE,HOUR[,DURATION]          rooms free for the block
+//   first,DATE,DURATION                earliest free block on DATE
+//   nearest,DATE,HOUR,DURATION,ROOM    closest free alternative
+//   archive,DATE         archive every week that ends before DATE
+//   stats                counters, latency histograms and structure sizes
+// Blank lines and lines starting with '#' are skipped. Each command answers
+// with one JSON object on one line:
+//   {"line":N,"cmd":"book","status":"ok","bookings":[...]}
+// status is ok, conflict, waitlisted, not_found, archived (the date's week
+// is archived and read-only) or error (with "message"). A conflict carries
+// the nearest free alternative, if any, as "alternative"; a series lists
+// every taken date as "conflicts" and books none of them, or with waitlist
+// books the rest and queues those.
+// Changes are only logged; the caller decides when to CommitChanges.
+
+inline void splitFields(const string& line, vector<string>& fields) {
+    fields.clear();
+    size_t start = 0, comma;
+    while ((comma = line.find(',', start)) != string::npos) {
+        fields.push_back(line.substr(start, comma - start));
+        start = comma + 1;
+    }
+    fields.push_back(line.substr(start));
+}
+
+inline bool parseInt(const string& s, int& value) {
+    if (s.empty() || s.size() > 9) return false;
+
+    value = 0;
+    for (size_t i = 0; i < s.size(); i++) {
+        if (s[i] < '0' || s[i] > '9') return false;
+        value = value * 10 + (s[i] - '0');
+    }
+    return true;
+}
+
+class CommandResult {
+    private:
+    string& out;
+    bool listed;
+    bool errored;
+    size_t items;
+
+    public:
+    CommandResult(string& output, int line, const string& cmd) : out(output) {
+        listed = false;
+        errored = false;
+        items = 0;
+        out += "{\"line\":" + to_string(line) + ",\"cmd\":";
+        appendJsonString(out, cmd);
+    }
+
+    void status(const char* s) {
+        out += ",\"status\":\"";
+        out += s;
+        out += '"';
+    }
+
+    void error(const string& message) {
+        status("error");
+        errored = true;
+        out += ",\"message\":";
+        appendJsonString(out, message);
+    }
+
+    void field(const char* name, long long value) {
+        out += ",\"";
+        out += name;
+        out += "\":" + to_string(value);
+    }
+
+    void slot(const char* name, const Booking& b) {
+        out += ",\"";
+        out += name;
+        out += "\":{\"date\":\"" + formatDate(b.date) + "\",\"hour\":" + to_string(b.hour)
+             + ",\"room\":" + to_string(b.room) + "}";
+    }
+
+    void rooms(const vector<int>& list) {
+        out += ",\"rooms\":[";
+        for (size_t i = 0; i < list.size(); i++) {
+            if (i > 0) out += ',';
+            out += to_string(list[i]);
+        }
+        out += ']';
+    }
+
+    void dates(const char* name, const vector<int>& list) {
+        out += ",\"";
+        out += name;
+        out += "\":[";
+        for (size_t i = 0; i < list.size(); i++) {
+            if (i > 0) out += ',';
+            out += '"' + formatDate(list[i]) + '"';
+        }
+        out += ']';
+    }
+
+    void openList() {
+        if (!listed) out += ",\"bookings\":[";
+        listed = true;
+    }
+
+    void booking(const Booking& b) {
+        openList();
+        if (items++ > 0) out += ',';
+        appendJsonBooking(out, b);
+    }
+
+    void bookings(const vector<Booking>& list, const char* name) {
+        out += ",\"";
+        out += name;
+        out += "\":[";
+        for (size_t i = 0; i < list.size(); i++) {
+            if (i > 0) out += ',';
+            appendJsonBooking(out, list[i]);
+        }
+        out += ']';
+    }
+
+    bool failed() {
+        return errored;
+    }
+
+    void end() {
+        if (listed) out += ']';
+        out += "}\n";
+    }
+};
+
+// Rooms 1..ROOM_COUNT, the rooms the menu, the free-room search and the
+// occupancy bitmaps know about.
+inline bool parseRoomNumber(const string& text, int& room) {
+    return parseRoom(text, room) && room <= ROOM_COUNT;
+}
+
+inline bool parseSlotFields(const vector<string>& f, size_t first, bool withDuration,
+                            int& day, int& hour, int& duration, int& room, string& error) {
+    size_t roomField = first + (withDuration ? 3 : 2);
+    duration = 1;
+    if (!parseDate(f[first], day)) {
+        error = "invalid date";
+    } else if (!parseInt(f[first + 1], hour) || !validHour(hour)) {
+        error = "invalid hour";
+    } else if (withDuration && (!parseInt(f[first + 2], duration) || !validDuration(hour, duration))) {
+        error = "invalid duration";
+    } else if (!parseRoomNumber(f[roomField], room)) {
+        error = "invalid room";
+    } else {
+        return true;
+    }
+    return false;
+}
+
+// Commands that never change bookings or waitlists, and so may run
+// alongside each other.
+inline bool IsReadOnlyCommand(const string& command) {
+    size_t comma = command.find(',');
+    string name = command.substr(0, comma);
+    return name == "search" || name == "waitlist" || name == "report" ||
+           name == "free" || name == "first" || name == "nearest";
+}
+
+// A waitlisted booking of a block that is already taken only joins the
+// waitlists, which may run alongside reads and other joins (see
+// waitlist.hpp), so these are worth trying with the engine lock shared.
+inline bool MayJoinWaitlist(const string& command) {
+    const string flag = ",waitlist";
+    return command.compare(0, 5, "book,") == 0 && command.size() > flag.size() &&
+           command.compare(command.size() - flag.size(), flag.size(), flag) == 0;
+}
+
+// COMMAND_EXCLUSIVE: the command needs the engine lock held exclusively;
+// nothing was done and nothing appended to out.
+enum CommandOutcome { COMMAND_SKIPPED, COMMAND_DONE, COMMAND_FAILED, COMMAND_EXCLUSIVE };
+
+// Runs one command line and appends its JSON result to out. shared means
+// the caller holds the engine lock shared: read-only commands run, and so
+// does a waitlisted booking if its block is taken; anything else returns
+// COMMAND_EXCLUSIVE.
+inline CommandOutcome ExecuteCommand(BookingStore& store, const string& text, int line, string& out,
+                                     bool shared = false) {
+    string command = text;
+    if (!command.empty() && command[command.size() - 1] == '\r')
+        command.erase(command.size() - 1);
+    if (command.empty() || command[0] == '#') return COMMAND_SKIPPED;
+
+    vector<string> f;
+    splitFields(command, f);
+    if (shared && !IsReadOnlyCommand(command) && f[0] != "book") return COMMAND_EXCLUSIVE;
+
+    size_t start = out.size();
+    CommandResult result(out, line, f[0]);
+    string error;
+    int day, hour, duration, room;
+
+    if (f[0] == "book") {
+        if (f.size() != 7 && !(f.size() == 8 && f[7] == "waitlist")) {
+            result.error("usage: book,DATE,HOUR,DURATION,ROOM,LECTURER,COURSE[,waitlist]");
+        } else if (!parseSlotFields(f, 1, true, day, hour, duration, room, error)) {
+            result.error(error);
+        } else {
+            Booking b;
+            makeBooking(f[1], hour, f[4], f[5], f[6], b);
+            Materialize(store);
+            if (IsArchived(store, day)) {
+                result.status("archived");
+            } else if (f.size() == 8 && BlockTaken(store, day, room, hour, duration)) {
+                JoinWaitlist(store, b, duration);
+                result.status("waitlisted");
+            } else if (shared) {
+                out.resize(start);
+                return COMMAND_EXCLUSIVE;
+            } else if (BookSlots(store, b, duration)) {
+                result.status("ok");
+            } else {
+                result.status("conflict");
+                Booking alternative;
+                if (NearestFreeSlot(store, day, room, hour, duration, alternative))
+                    result.slot("alternative", alternative);
+            }
+        }
+    } else if (f[0] == "series") {
+        int lastDay;
+        if (f.size() != 8 && !(f.size() == 9 && f[8] == "waitlist")) {
+            result.error("usage: series,DATE,HOUR,DURATION,ROOM,LECTURER,COURSE,UNTIL[,waitlist]");
+        } else if (!parseSlotFields(f, 1, true, day, hour, duration, room, error)) {
+            result.error(error);
+        } else if (!parseDate(f[7], lastDay) || lastDay < day) {
+            result.error("invalid end date");
+        } else {
+            Booking b;
+            makeBooking(f[1], hour, f[4], f[5], f[6], b);
+            vector<int> booked, conflicts;
+            if (!BookSeries(store, b, duration, lastDay, f.size() == 9, booked, conflicts)) {
+                result.status("archived");
+            } else {
+                result.status(conflicts.empty() ? "ok" : f.size() == 9 ? "waitlisted" : "conflict");
+                result.dates("booked", booked);
+                result.dates("conflicts", conflicts);
+            }
+        }
+    } else if (f[0] == "cancel") {
+        if (f.size() != 5) {
+            result.error("usage: cancel,DATE,HOUR,DURATION,ROOM");
+        } else if (!parseSlotFields(f, 1, true, day, hour, duration, room, error)) {
+            result.error(error);
+        } else if (IsArchived(store, day)) {
+            result.status("archived");
+        } else {
+            vector<Booking> removed, promoted;
+            CancelSlots(store, day, room, hour, duration, removed, promoted);
+            result.status(removed.empty() ? "not_found" : "ok");
+            result.bookings(removed, "cancelled");
+            result.bookings(promoted, "promoted");
+        }
+    } else if (f[0] == "search" || f[0] == "waitlist") {
+        if (f.size() != 4) {
+            result.error("usage: " + f[0] + ",DATE,HOUR,ROOM");
+        } else if (!parseSlotFields(f, 1, false, day, hour, duration, room, error)) {
+            result.error(error);
+        } else if (f[0] == "search") {
+            Booking b;
+            bool found = FindBooking(store, makeSlotKey(day, room, hour), b);
+            result.status(found ? "ok" : "not_found");
+            if (found) result.booking(b);
+        } else {
+            WaitlistRegistry* waitlists = WaitlistsFor(store, day);
+            WaitlistQueue* wq = waitlists != NULL ? waitlists->find(makeSlotKey(day, room, hour)) : NULL;
+            result.status(wq != NULL ? "ok" : "not_found");
+            result.openList();
+            if (wq != NULL)
+                wq->forEach([&](const Booking& b) { result.booking(b); });
+        }
+    } else if (f[0] == "report") {
+        const char* usage = "usage: report,all | report,date,DATE | report,room,ROOM[,FROM,TO] | "
+                            "report,lecturer,NAME | report,course,NAME";
+        int fromDay = 0, toDay = 0;
+        if (f.size() < 2) {
+            result.error(usage);
+        } else if (f.size() == 2 && f[1] == "all") {
+            vector<Booking> rows;
+            Materialize(store);
+            CollectAll(store, rows);
+            result.status("ok");
+            result.openList();
+            for (size_t i = 0; i < rows.size(); i++)
+                result.booking(rows[i]);
+        } else if (f.size() == 3 && f[1] == "date") {
+            if (!parseDate(f[2], day)) {
+                result.error("invalid date");
+            } else {
+                vector<Booking> rows;
+                DateSchedule(store, day, rows);
+                result.status("ok");
+                result.openList();
+                for (size_t i = 0; i < rows.size(); i++)
+                    result.booking(rows[i]);
+            }
+        } else if (f.size() == 3 && (f[1] == "lecturer" || f[1] == "course")) {
+            vector<Booking> rows;
+            Materialize(store);
+            if (f[1] == "lecturer") {
+                LecturerIs filter = {f[2]};
+                CollectMatching(store, filter, rows);
+            } else {
+                CourseIs filter = {f[2]};
+                CollectMatching(store, filter, rows);
+            }
+            result.status("ok");
+            result.openList();
+            for (size_t i = 0; i < rows.size(); i++)
+                result.booking(rows[i]);
+        } else if (f[1] == "room" && (f.size() == 3 || f.size() == 5)) {
+            if (!parseRoomNumber(f[2], room)) {
+                result.error("invalid room");
+            } else if (f.size() == 5 && (!parseDate(f[3], fromDay) || !parseDate(f[4], toDay))) {
+                result.error("invalid date");
+            } else {
+                vector<Booking> rows;
+                RoomSchedule(store, room, f.size() == 5 ? fromDay : 0, f.size() == 5 ? toDay : LAST_DAY, rows);
+                result.status("ok");
+                result.openList();
+                for (size_t i = 0; i < rows.size(); i++)
+                    result.booking(rows[i]);
+            }
+        } else {
+            result.error(usage);
+        }
+    } else if (f[0] == "free") {
+        duration = 1;
+        if (f.size() != 3 && f.size() != 4) {
+            result.error("usage: free,DATE,HOUR[,DURATION]");
+        } else if (!parseDate(f[1], day)) {
+            result.error("invalid date");
+        } else if (!parseInt(f[2], hour) || !validHour(hour)) {
+            result.error("invalid hour");
+        } else if (f.size() == 4 && (!parseInt(f[3], duration) || !validDuration(hour, duration))) {
+            result.error("invalid duration");
+        } else {
+            vector<int> rooms;
+            Materialize(store);
+            FreeRooms(store, day, hour, duration, rooms);
+            result.status(IsArchived(store, day) ? "archived" : "ok");
+            result.rooms(rooms);
+        }
+    } else if (f[0] == "first") {
+        if (f.size() != 3 || !parseDate(f[1], day) || !parseInt(f[2], duration)) {
+            result.error("usage: first,DATE,DURATION");
+        } else {
+            Booking b;
+            b.date = day;
+            Materialize(store);
+            if (IsArchived(store, day)) {
+                result.status("archived");
+            } else if (FirstFreeBlock(store, day, duration, b.room, b.hour)) {
+                result.status("ok");
+                result.slot("slot", b);
+            } else {
+                result.status("not_found");
+            }
+        }
+    } else if (f[0] == "nearest") {
+        if (f.size() != 5) {
+            result.error("usage: nearest,DATE,HOUR,DURATION,ROOM");
+        } else if (!parseSlotFields(f, 1, true, day, hour, duration, room, error)) {
+            result.error(error);
+        } else {
+            Booking b;
+            Materialize(store);
+            if (NearestFreeSlot(store, day, room, hour, duration, b)) {
+                result.status("ok");
+                result.slot("slot", b);
+            } else {
+                result.status("not_found");
+            }
+        }
+    } else if (f[0] == "stats") {
+        vector<StatValue> values;
+        CollectStats(store, values);
+        result.status("ok");
+        for (size_t i = 0; i < values.size(); i++)
+            result.field(values[i].name.c_str(), (long long)values[i].value);
+    } else if (f[0] == "archive") {
+        if (f.size() != 2 || !parseDate(f[1], day)) {
+            result.error("usage: archive,DATE");
+        } else {
+            int weeks = ArchiveBefore(store, day);
+            if (weeks < 0) {
+                result.error("cannot write archive");
+            } else {
+                result.status("ok");
+                result.field("weeks", weeks);
+            }
+        }
+    } else {
+        result.error("unknown command");
+    }
+
+    result.end();
+    return result.failed() ? COMMAND_FAILED : COMMAND_DONE;
+}
+
+#endif
@@ -0,0 +1,275 @@
+// Allocation counts and timings for the queue and stack containers. Every
+// call to the global operator new is counted, so each row shows how many
+// heap allocations its operations cost.
+//
+// Booking rows use the engine's own record. TextBooking rows use a record
+// of four strings, the shape bookings had before names were interned, to
+// show what copying an item costs next to moving or constructing it in
+// place: the copy rows are the by-value push/peek/pop of the old API, the
+// others the move, emplace and pointer accessors that replace it.
+//
+// The waitlist rows compare the linked Queue with the two halves of every
+// slot's WaitlistQueue: the lock-free ConcurrentWaitlistQueue that joins
+// go to, whose nodes come from the heap, and the RingQueue that promotion
+// moves them to. They fill --lists queues in turn, so each linked queue's
+// nodes are spread through the pool or heap, then size, walk and drain
+// every queue.
+//
+//   container_bench [--ops 1000000] [--lists 1000]
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <chrono>
+#include <cstdlib>
+#include <new>
+#include <vector>
+#include <memory>
+#include "queue.hpp"
+#include "stack.hpp"
+using namespace std;
+
+static size_t allocations = 0;
+
+void* operator new(size_t size) {
+    allocations++;
+    void* p = malloc(size == 0 ? 1 : size);
+    if (p == NULL) throw bad_alloc();
+    return p;
+}
+
+void operator delete(void* p) noexcept {
+    free(p);
+}
+
+void operator delete(void* p, size_t) noexcept {
+    free(p);
+}
+
+// Long enough that none of the strings fits in the small-string buffer.
+struct TextBooking {
+    string date;
+    string room;
+    string lecturer;
+    string course;
+
+    TextBooking() {}
+    TextBooking(const string& d, const string& r, const string& l, const string& c)
+        : date(d), room(r), lecturer(l), course(c) {}
+};
+
+TextBooking SampleText() {
+    return TextBooking("2026-10-20 09:00 to 10:00", "Engineering Block Room 101",
+                       "Lecturer Number One Hundred", "Course Code C100 Section A");
+}
+
+Booking SampleBooking(int i) {
+    Booking b;
+    b.date = 20000 + i % 365;
+    b.hour = 8 + i % 10;
+    b.room = 1 + i % 20;
+    b.lecturer = i % 200;
+    b.course = i % 200;
+    return b;
+}
+
+class BenchRow {
+    private:
+    string name;
+    long long ops;
+    size_t startAllocations;
+    chrono::steady_clock::time_point start;
+
+    public:
+    BenchRow(const string& n, long long count) {
+        name = n;
+        ops = count;
+        startAllocations = allocations;
+        start = chrono::steady_clock::now();
+    }
+
+    ~BenchRow() {
+        double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        size_t used = allocations - startAllocations;
+        cout << name << "," << ops << "," << used << ","
+             << fixed << setprecision(3) << (double)used / ops << ","
+             << setprecision(1) << seconds * 1e9 / ops << "\n";
+    }
+};
+
+// The old by-value API: push(T) copies into the parameter and again into
+// the node, pop() and peek() return copies.
+template <class T>
+T PopCopy(Stack<T>& stack) {
+    T item = *stack.peek();
+    stack.pop();
+    return item;
+}
+
+template <class T>
+T DeQueueCopy(Queue<T>& queue) {
+    T item = *queue.getFront();
+    queue.deQueue();
+    return item;
+}
+
+template <class T>
+void PushByValue(Stack<T>& stack, T item) {
+    stack.push(item);
+}
+
+template <class T>
+void EnQueueByValue(Queue<T>& queue, T item) {
+    queue.enQueue(item);
+}
+
+void BenchBookings(long long ops) {
+    {
+        Stack<Booking> stack;
+        {
+            BenchRow row("stack_booking_push", ops);
+            for (long long i = 0; i < ops; i++)
+                stack.push(SampleBooking(i));
+        }
+        long long sum = 0;
+        {
+            BenchRow row("stack_booking_peek_pop", ops);
+            Booking b;
+            while (stack.pop(b))
+                sum += b.room;
+        }
+        if (sum == 0) cout << "";
+    }
+    {
+        Queue<Booking> queue;
+        {
+            BenchRow row("queue_booking_enqueue", ops);
+            for (long long i = 0; i < ops; i++)
+                queue.enQueue(SampleBooking(i));
+        }
+        long long sum = 0;
+        {
+            BenchRow row("queue_booking_dequeue", ops);
+            Booking b;
+            while (queue.deQueue(b))
+                sum += b.room;
+        }
+        if (sum == 0) cout << "";
+    }
+}
+
+void BenchText(long long ops) {
+    TextBooking sample = SampleText();
+    long long sum = 0;
+    {
+        Stack<TextBooking> stack;
+        {
+            BenchRow row("stack_text_push_copy", ops);
+            for (long long i = 0; i < ops; i++)
+                PushByValue(stack, sample);
+        }
+        {
+            BenchRow row("stack_text_pop_copy", ops);
+            while (!stack.isEmpty())
+                sum += PopCopy(stack).room.size();
+        }
+        {
+            BenchRow row("stack_text_emplace", ops);
+            for (long long i = 0; i < ops; i++)
+                stack.emplace(sample.date, sample.room, sample.lecturer, sample.course);
+        }
+        {
+            BenchRow row("stack_text_peek_pop_move", ops);
+            TextBooking b;
+            while (!stack.isEmpty()) {
+                sum += stack.peek()->room.size();
+                stack.pop(b);
+            }
+        }
+    }
+    {
+        Queue<TextBooking> queue;
+        {
+            BenchRow row("queue_text_enqueue_copy", ops);
+            for (long long i = 0; i < ops; i++)
+                EnQueueByValue(queue, sample);
+        }
+        {
+            BenchRow row("queue_text_dequeue_copy", ops);
+            while (!queue.isEmpty())
+                sum += DeQueueCopy(queue).room.size();
+        }
+        {
+            BenchRow row("queue_text_enqueue_move", ops);
+            for (long long i = 0; i < ops; i++) {
+                TextBooking b = sample;
+                queue.enQueue(std::move(b));
+            }
+        }
+        {
+            BenchRow row("queue_text_dequeue_move", ops);
+            TextBooking b;
+            while (queue.deQueue(b))
+                sum += b.room.size();
+        }
+    }
+    if (sum == 0) cout << "";
+}
+
+template <class Q>
+void BenchWaitlists(const string& kind, long long ops, int lists) {
+    vector<unique_ptr<Q> > queues;
+    for (int i = 0; i < lists; i++)
+        queues.push_back(unique_ptr<Q>(new Q()));
+
+    long long sum = 0;
+    {
+        BenchRow row("waitlist_" + kind + "_enqueue", ops);
+        for (long long i = 0; i < ops; i++)
+            queues[i % lists]->enQueue(SampleBooking(i));
+    }
+    {
+        BenchRow row("waitlist_" + kind + "_size", ops);
+        for (int i = 0; i < lists; i++)
+            sum += queues[i]->getSize();
+    }
+    {
+        BenchRow row("waitlist_" + kind + "_walk", ops);
+        for (int i = 0; i < lists; i++)
+            queues[i]->forEach([&](const Booking& b) { sum += b.lecturer; });
+    }
+    {
+        BenchRow row("waitlist_" + kind + "_dequeue", ops);
+        Booking b;
+        for (int i = 0; i < lists; i++) {
+            while (queues[i]->deQueue(b))
+                sum += b.room;
+        }
+    }
+    if (sum == 0) cout << "";
+}
+
+int main(int argc, char* argv[]) {
+    long long ops = 1000000;
+    int lists = 1000;
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if (arg == "--ops" && i + 1 < argc) {
+            ops = atoll(argv[++i]);
+        } else if (arg == "--lists" && i + 1 < argc) {
+            lists = atoi(argv[++i]);
+        } else {
+            cerr << "usage: container_bench [--ops 1000000] [--lists 1000]\n";
+            return 1;
+        }
+    }
+    if (ops <= 0) ops = 1;
+    if (lists <= 0) lists = 1;
+
+    cout << "benchmark,ops,allocations,allocs_per_op,ns_per_op\n";
+    BenchBookings(ops);
+    BenchText(ops);
+    BenchWaitlists<Queue<Booking> >("linked", ops, lists);
+    BenchWaitlists<RingQueue<Booking> >("ring", ops, lists);
+    BenchWaitlists<ConcurrentWaitlistQueue>("mpsc", ops, lists);
+    return 0;
+}
@@ -0,0 +1,132 @@
+#ifndef INTERN_HPP
+#define INTERN_HPP
+
+#include <cstddef>
+#include <cstring>
+#include <string>
+#include <mutex>
+using namespace std;
+
+// Interns lecturer and course names. Each distinct string is stored once and
+// bookings carry its small integer id. Id 0 is the empty string. Lookups go
+// through an open-addressing table of ids, so finding an existing name from
+// a (pointer, length) pair never allocates. Names live in fixed-size blocks
+// that never move, so threads may intern while others read names by id.
+// Interning itself is serialised: an archived shard loading and waitlist
+// joins both intern under the engine lock held shared (see store.hpp and
+// server.hpp).
+class StringTable {
+    private:
+    static const size_t BLOCK_BITS = 12;
+    static const size_t BLOCK_SIZE = 1 << BLOCK_BITS;
+    static const size_t MAX_BLOCKS = 1 << 14;
+
+    string* blocks[MAX_BLOCKS];
+    size_t count;
+    int* slots;
+    size_t capacity;
+    size_t textBytes;
+    mutex tableLock;
+
+    static size_t hash(const char* s, size_t len) {
+        size_t h = 14695981039346656037ULL;
+        for (size_t i = 0; i < len; i++) {
+            h ^= (unsigned char)s[i];
+            h *= 1099511628211ULL;
+        }
+        return h;
+    }
+
+    size_t findSlot(const char* s, size_t len) {
+        size_t mask = capacity - 1;
+        size_t i = hash(s, len) & mask;
+        while (slots[i] >= 0) {
+            const string& name = this->name(slots[i]);
+            if (name.size() == len && memcmp(name.data(), s, len) == 0)
+                return i;
+            i = (i + 1) & mask;
+        }
+        return i;
+    }
+
+    void grow() {
+        delete[] slots;
+        capacity *= 2;
+        slots = new int[capacity];
+        for (size_t i = 0; i < capacity; i++)
+            slots[i] = -1;
+        for (size_t id = 0; id < count; id++)
+            slots[findSlot(name(id).data(), name(id).size())] = (int)id;
+    }
+
+    public:
+    StringTable() {
+        capacity = 64;
+        count = 0;
+        textBytes = 0;
+        for (size_t i = 0; i < MAX_BLOCKS; i++)
+            blocks[i] = NULL;
+        slots = new int[capacity];
+        for (size_t i = 0; i < capacity; i++)
+            slots[i] = -1;
+        intern("", 0);
+    }
+
+    ~StringTable() {
+        for (size_t i = 0; i < MAX_BLOCKS; i++)
+            delete[] blocks[i];
+        delete[] slots;
+    }
+
+    int intern(const char* s, size_t len) {
+        lock_guard<mutex> held(tableLock);
+        size_t i = findSlot(s, len);
+        if (slots[i] >= 0) return slots[i];
+
+        if ((count + 1) * 2 > capacity) {
+            grow();
+            i = findSlot(s, len);
+        }
+
+        string*& block = blocks[count >> BLOCK_BITS];
+        if (block == NULL)
+            block = new string[BLOCK_SIZE];
+        block[count & (BLOCK_SIZE - 1)].assign(s, len);
+        textBytes += len;
+        slots[i] = (int)count++;
+        return slots[i];
+    }
+
+    int intern(const string& s) {
+        return intern(s.data(), s.size());
+    }
+
+    // Returns the id of s without adding it, or -1.
+    int lookup(const char* s, size_t len) {
+        lock_guard<mutex> held(tableLock);
+        return slots[findSlot(s, len)];
+    }
+
+    const string& name(int id) {
+        return blocks[id >> BLOCK_BITS][id & (BLOCK_SIZE - 1)];
+    }
+
+    size_t size() {
+        return count;
+    }
+
+    size_t memoryUsage() {
+        size_t usedBlocks = (count + BLOCK_SIZE - 1) >> BLOCK_BITS;
+        return sizeof(*this) + capacity * sizeof(int)
+             + usedBlocks * BLOCK_SIZE * sizeof(string) + textBytes;
+    }
+};
+
+// The process-wide name table. Never destroyed, so it outlives every global
+// that still holds ids at exit.
+inline StringTable& Names() {
+    static StringTable* table = new StringTable();
+    return *table;
+}
+
+#endif
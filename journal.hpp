@@ -0,0 +1,366 @@
+#ifndef JOURNAL_HPP
+#define JOURNAL_HPP
+
+#include <string>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <fcntl.h>
+#include "queue.hpp"
+#include "slotkey.hpp"
+#include "stats.hpp"
+#ifdef _WIN32
+#include <io.h>
+#define fsync _commit
+#else
+#include <unistd.h>
+#endif
+using namespace std;
+
+// bookings.txt (or bookings.bin, see snapshot.hpp) is a snapshot; every
+// change made after it is appended to bookings.journal as one line:
+//   I,date,hour,room,lecturer,course   booking inserted
+//   P,date,hour,room,lecturer,course   first in the slot's waitlist promoted
+//   D,date,hour,room                   booking deleted
+//   W,date,hour,room,lecturer,course   booking joined the slot's waitlist
+//   R                                  all waitlists emptied
+// Compaction renames the journal to bookings.journal.old, starts a fresh
+// one and writes the new snapshot on a background thread. Startup replays
+// snapshot, old journal, journal; replaying an already-applied record is
+// harmless because inserts of taken slots and deletes of free ones are no-ops.
+//
+// Waitlists are not in the snapshot. Every fresh journal starts with an R
+// record and a W record per waiting booking, in queue order, so replaying
+// the journal files in order always ends with the queues as they were.
+//
+// How soon a commit is on disk depends on the journal's durability mode:
+//   sync    commit() writes and fsyncs before it returns (the default)
+//   group   a writer thread writes and fsyncs; commit() waits for the
+//           write that holds its records, and commits that arrive while
+//           one is syncing share the next fsync
+//   async   commit() hands the records to the writer thread and returns at
+//           once; the writer gathers JOURNAL_ASYNC_WINDOW_MS of changes per
+//           write, so a crash can lose that much
+// close() always writes everything out first.
+const char* const BOOKINGS_FILE = "bookings.txt";
+const char* const JOURNAL_FILE = "bookings.journal";
+const char* const JOURNAL_OLD_FILE = "bookings.journal.old";
+
+inline bool writeAll(int fd, const char* data, size_t len) {
+    while (len > 0) {
+        int n = ::write(fd, data, len);
+        if (n <= 0) return false;
+        data += n;
+        len -= n;
+    }
+    return true;
+}
+
+// Writes path.tmp, syncs it and renames it over path.
+inline bool writeFileAtomic(const string& path, const string& data) {
+    string tmp = path + ".tmp";
+    int fd = ::open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) return false;
+
+    bool ok = writeAll(fd, data.data(), data.size()) && fsync(fd) == 0;
+    ::close(fd);
+    if (!ok) return false;
+
+#ifdef _WIN32
+    remove(path.c_str());
+#endif
+    return rename(tmp.c_str(), path.c_str()) == 0;
+}
+
+enum Durability { DURABILITY_SYNC, DURABILITY_GROUP, DURABILITY_ASYNC };
+
+const int JOURNAL_ASYNC_WINDOW_MS = 50;
+
+inline bool parseDurability(const string& text, Durability& mode) {
+    if (text == "sync") mode = DURABILITY_SYNC;
+    else if (text == "group") mode = DURABILITY_GROUP;
+    else if (text == "async") mode = DURABILITY_ASYNC;
+    else return false;
+    return true;
+}
+
+class Journal {
+    private:
+    int fd;
+    string pending;
+    int records;
+    thread compactor;
+    atomic<bool> compactionFailed;
+
+    // The writer thread, in group and async modes. Committed records move
+    // from pending to queued; the writer swaps queued for its own empty
+    // buffer and writes that while new commits fill queued again. Each
+    // commit is numbered, and durable is the last one synced. fd only
+    // changes while the writer is idle: compaction and close flush first.
+    Durability durability;
+    thread writer;
+    mutex writerLock;
+    condition_variable writerWake;
+    condition_variable writerDone;
+    string queued;
+    uint64_t submitted;
+    uint64_t durable;
+    bool stopping;
+    bool hurry;
+    bool writeFailed;
+
+    bool writeBatch(const string& batch) {
+        STAT_TIMER(commit);
+        return writeAll(fd, batch.data(), batch.size()) && fsync(fd) == 0;
+    }
+
+    void writerLoop() {
+        string writing;
+        unique_lock<mutex> held(writerLock);
+        while (true) {
+            writerWake.wait(held, [this]() { return !queued.empty() || stopping; });
+            if (queued.empty()) break;
+            if (durability == DURABILITY_ASYNC && !stopping && !hurry)
+                writerWake.wait_for(held, chrono::milliseconds(JOURNAL_ASYNC_WINDOW_MS),
+                                    [this]() { return stopping || hurry; });
+
+            hurry = false;
+            writing.swap(queued);
+            uint64_t batch = submitted;
+            held.unlock();
+            bool ok = writeBatch(writing);
+            writing.clear();
+            held.lock();
+
+            if (!ok) writeFailed = true;
+            durable = batch;
+            writerDone.notify_all();
+        }
+    }
+
+    void startWriter() {
+        if (durability == DURABILITY_SYNC || writer.joinable()) return;
+        stopping = false;
+        writer = thread([this]() { writerLoop(); });
+    }
+
+    void stopWriter() {
+        if (!writer.joinable()) return;
+        {
+            lock_guard<mutex> held(writerLock);
+            stopping = true;
+        }
+        writerWake.notify_all();
+        writer.join();
+    }
+
+    // Waitlist joins log from many threads at once, so records go into
+    // pending under the writer lock.
+    void append(char op, const Booking& b, bool keyOnly) {
+        lock_guard<mutex> held(writerLock);
+        pending += op;
+        pending += ',' + formatDate(b.date) + ',' + to_string(b.hour) + ',' + to_string(b.room);
+        if (!keyOnly)
+            pending += ',' + Names().name(b.lecturer) + ',' + Names().name(b.course);
+        pending += '\n';
+        records++;
+    }
+
+    void reopen(bool truncate) {
+        if (fd >= 0) ::close(fd);
+        fd = ::open(JOURNAL_FILE, O_WRONLY | O_CREAT | O_APPEND | (truncate ? O_TRUNC : 0), 0644);
+    }
+
+    public:
+    int compactThreshold;
+    string snapshotPath;
+
+    Journal() {
+        snapshotPath = BOOKINGS_FILE;
+        fd = -1;
+        records = 0;
+        compactionFailed = false;
+        compactThreshold = 1000;
+        durability = DURABILITY_SYNC;
+        submitted = 0;
+        durable = 0;
+        stopping = false;
+        hurry = false;
+        writeFailed = false;
+    }
+
+    ~Journal() {
+        close();
+    }
+
+    // Takes effect at the next open().
+    void setDurability(Durability mode) {
+        durability = mode;
+    }
+
+    // replayed is the number of records already in the journal files.
+    bool open(int replayed) {
+        records = replayed;
+        reopen(false);
+        startWriter();
+        return fd >= 0;
+    }
+
+    void close() {
+        flush();
+        stopWriter();
+        waitForCompaction();
+        if (fd >= 0) ::close(fd);
+        fd = -1;
+    }
+
+    void logInsert(const Booking& b) {
+        append('I', b, false);
+    }
+
+    void logPromote(const Booking& b) {
+        append('P', b, false);
+    }
+
+    void logDelete(const Booking& b) {
+        append('D', b, true);
+    }
+
+    void logWaitlist(const Booking& b) {
+        append('W', b, false);
+    }
+
+    // Hands everything logged since the last submit to be written, in
+    // sync mode by writing and syncing it now. Returns its commit number
+    // for waitDurable. Any thread may call this; records logged by other
+    // threads in the meantime go in the same commit.
+    uint64_t submit() {
+        lock_guard<mutex> held(writerLock);
+        if (pending.empty()) return submitted;
+        if (fd < 0) {
+            writeFailed = true;
+            pending.clear();
+            return submitted;
+        }
+
+        submitted++;
+        if (!writer.joinable()) {
+            if (!writeBatch(pending)) writeFailed = true;
+            durable = submitted;
+        } else {
+            if (queued.empty())
+                queued.swap(pending);
+            else
+                queued += pending;
+            writerWake.notify_one();
+        }
+        pending.clear();
+        return submitted;
+    }
+
+    // In group mode waits until commit number ticket is synced; other
+    // modes never wait. False once any write has failed. Any thread may
+    // call this.
+    bool waitDurable(uint64_t ticket) {
+        unique_lock<mutex> held(writerLock);
+        if (durability == DURABILITY_GROUP)
+            writerDone.wait(held, [&]() { return durable >= ticket; });
+        return !writeFailed;
+    }
+
+    // Makes everything logged since the last commit durable, or as durable
+    // as the mode promises, with a single write and a single fsync.
+    bool commit() {
+        return waitDurable(submit());
+    }
+
+    // Writes and syncs everything logged so far, whatever the mode.
+    bool flush() {
+        uint64_t ticket = submit();
+        unique_lock<mutex> held(writerLock);
+        if (durable < ticket) {
+            hurry = true;
+            writerWake.notify_one();
+        }
+        writerDone.wait(held, [&]() { return durable >= ticket; });
+        return !writeFailed;
+    }
+
+    bool needsCompaction() {
+        return records >= compactThreshold;
+    }
+
+    void waitForCompaction() {
+        if (compactor.joinable())
+            compactor.join();
+    }
+
+    // Starts writing snapshot (the full contents of snapshotPath) in the
+    // background and switches to a fresh journal holding just waitlists,
+    // the R and W records that restore the current queues. No thread may
+    // log meanwhile, or its record could miss both journals.
+    void compact(const string& snapshot, const string& waitlists) {
+        flush();
+        waitForCompaction();
+
+        if (compactionFailed || fileExists(JOURNAL_OLD_FILE)) {
+            compactNow(snapshot, waitlists);
+            return;
+        }
+
+        ::close(fd);
+        fd = -1;
+        if (rename(JOURNAL_FILE, JOURNAL_OLD_FILE) != 0) {
+            reopen(false);
+            return;
+        }
+        if (!writeFileAtomic(JOURNAL_FILE, waitlists)) {
+            rename(JOURNAL_OLD_FILE, JOURNAL_FILE);
+            reopen(false);
+            return;
+        }
+        reopen(false);
+        records = 0;
+
+        compactor = thread([this, snapshot]() {
+            STAT_TIMER(compaction);
+            if (writeFileAtomic(snapshotPath, snapshot))
+                remove(JOURNAL_OLD_FILE);
+            else
+                compactionFailed = true;
+        });
+    }
+
+    // Synchronous compaction, used when an earlier one did not finish.
+    bool compactNow(const string& snapshot, const string& waitlists) {
+        flush();
+        waitForCompaction();
+
+        if (!writeFileAtomic(snapshotPath, snapshot)) {
+            compactionFailed = true;
+            return false;
+        }
+        remove(JOURNAL_OLD_FILE);
+        if (!writeFileAtomic(JOURNAL_FILE, waitlists)) {
+            reopen(false);
+            return false;
+        }
+        reopen(false);
+        records = 0;
+        compactionFailed = false;
+        return true;
+    }
+
+    static bool fileExists(const char* path) {
+        FILE* f = fopen(path, "r");
+        if (f == NULL) return false;
+        fclose(f);
+        return true;
+    }
+};
+
+#endif
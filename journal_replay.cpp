@@ -0,0 +1,87 @@
+// Checks journal replay at startup against a binary snapshot. A journal
+// holding only waitlist records, as every compaction leaves it, must
+// restore the queues and leave the store answering from the mapped
+// snapshot; a booking record must build the trees and apply on top, and
+// a record of an unknown type must be skipped.
+//
+// The checks work in their own directory and replace the bookings files
+// there.
+//
+//   journal_replay [dir]
+#include <iostream>
+#include <string>
+#include <cstdio>
+#ifdef _WIN32
+#include <direct.h>
+#define chdir _chdir
+#else
+#include <unistd.h>
+#endif
+#include "booking.hpp"
+using namespace std;
+
+bool Expect(bool condition, const string& what) {
+    if (!condition) cerr << "FAILED: " << what << "\n";
+    return condition;
+}
+
+void RemoveBookingFiles() {
+    remove(BOOKINGS_FILE);
+    remove(SNAPSHOT_BIN_FILE);
+    remove(JOURNAL_FILE);
+    remove(JOURNAL_OLD_FILE);
+}
+
+void Unload(BookingStore& store) {
+    journal.close();
+    snapshotView.close();
+    store.clear();
+}
+
+SlotKey Key(const char* date, int hour, const char* room) {
+    SlotKey key = 0;
+    makeKey(date, hour, room, key);
+    return key;
+}
+
+int main(int argc, char* argv[]) {
+    string dir = argc > 1 ? argv[1] : "journal_replay.tmp";
+    mkdir(dir.c_str(), 0755);
+    if (chdir(dir.c_str()) != 0) {
+        cerr << dir << ": cannot use as test directory\n";
+        return 1;
+    }
+
+    RemoveBookingFiles();
+    writeFileAtomic(BOOKINGS_FILE, "260105,10,5,Ann,C1\n260105,11,6,Dan,C4\n");
+    ConvertToBinary(BOOKINGS_FILE, SNAPSHOT_BIN_FILE);
+    remove(BOOKINGS_FILE);
+    writeFileAtomic(JOURNAL_FILE, "R\nW,260105,10,5,Bob,C2\nW,260105,10,5,Eve,C5\n");
+
+    bool ok = true;
+    BookingStore store;
+    Booking b;
+
+    ok &= Expect(LoadFromFile(store), "load with a waitlist-only journal");
+    ok &= Expect(snapshotView.isOpen(), "waitlist-only journal keeps the snapshot mapped");
+    ok &= Expect(store.count() == 0, "waitlist-only journal builds no trees");
+    ok &= Expect(FindBooking(store, Key("260105", 10, "5"), b), "snapshot booking found");
+    WaitlistRegistry* waitlists = WaitlistsFor(store, slotDay(Key("260105", 10, "5")));
+    WaitlistQueue* queue = waitlists != NULL ? waitlists->find(Key("260105", 10, "5")) : NULL;
+    ok &= Expect(queue != NULL && queue->getSize() == 2 &&
+                 Names().name(queue->getFront()->lecturer) == "Bob",
+                 "waitlist restored in order");
+    Unload(store);
+
+    writeFileAtomic(JOURNAL_FILE, "R\nW,260105,10,5,Bob,C2\nX,260107,9,4,Zed,C9\nI,260106,9,3,Cat,C3\n");
+    ok &= Expect(LoadFromFile(store), "load with a booking record");
+    ok &= Expect(!snapshotView.isOpen(), "booking record builds the trees");
+    ok &= Expect(store.count() == 3, "snapshot and journal bookings all present");
+    ok &= Expect(FindBooking(store, Key("260106", 9, "3"), b), "journal booking found");
+    ok &= Expect(!FindBooking(store, Key("260107", 9, "4"), b), "unknown record type skipped");
+    Unload(store);
+
+    RemoveBookingFiles();
+    cout << (ok ? "passed" : "FAILED") << "\n";
+    return ok ? 0 : 1;
+}
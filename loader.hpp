@@ -0,0 +1,202 @@
+#ifndef LOADER_HPP
+#define LOADER_HPP
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include "queue.hpp"
+#include "slotkey.hpp"
+#include "intern.hpp"
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+using namespace std;
+
+// Read-only view of a whole file: memory-mapped where the platform allows
+// it, otherwise read into one buffer.
+class MappedFile {
+    private:
+    bool mapped;
+
+    public:
+    const char* data;
+    size_t size;
+
+    MappedFile() {
+        mapped = false;
+        data = NULL;
+        size = 0;
+    }
+
+    ~MappedFile() {
+        close();
+    }
+
+    bool open(const char* path) {
+        close();
+#ifndef _WIN32
+        int fd = ::open(path, O_RDONLY);
+        if (fd < 0) return false;
+
+        struct stat st;
+        if (fstat(fd, &st) != 0) {
+            ::close(fd);
+            return false;
+        }
+        size = st.st_size;
+        if (size > 0) {
+            void* p = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (p != MAP_FAILED) {
+                madvise(p, size, MADV_SEQUENTIAL);
+                data = (const char*)p;
+                mapped = true;
+            }
+        }
+        ::close(fd);
+        if (mapped || size == 0) return true;
+#endif
+        FILE* f = fopen(path, "rb");
+        if (f == NULL) return false;
+
+        fseek(f, 0, SEEK_END);
+        size = ftell(f);
+        fseek(f, 0, SEEK_SET);
+        char* buffer = (char*)malloc(size + 1);
+        size = fread(buffer, 1, size, f);
+        fclose(f);
+        data = buffer;
+        return true;
+    }
+
+    void close() {
+#ifndef _WIN32
+        if (mapped) munmap((void*)data, size);
+#endif
+        if (!mapped) free((void*)data);
+        mapped = false;
+        data = NULL;
+        size = 0;
+    }
+};
+
+struct LoadError {
+    int line;
+    string message;
+};
+
+struct LoadedRow {
+    SlotKey key;
+    Booking info;
+    int line;
+};
+
+inline bool scanNumber(const char* s, const char* end, int maxDigits, int& value) {
+    if (s == end || end - s > maxDigits) return false;
+
+    value = 0;
+    for (; s < end; s++) {
+        if (*s < '0' || *s > '9') return false;
+        value = value * 10 + (*s - '0');
+    }
+    return true;
+}
+
+// Scans "date,hour,room,lecturer,course" lines without allocating (new
+// names excepted). Bad lines are skipped and reported by line number.
+// Returns true if the rows came out in strictly increasing slot order.
+inline bool ScanBookings(const char* data, size_t size, vector<LoadedRow>& rows,
+                         vector<LoadError>& errors) {
+    const char* p = data;
+    const char* end = data + size;
+    bool sorted = true;
+    int line = 0;
+
+    while (p < end) {
+        line++;
+        const char* eol = (const char*)memchr(p, '\n', end - p);
+        if (eol == NULL) eol = end;
+        const char* lineEnd = (eol > p && eol[-1] == '\r') ? eol - 1 : eol;
+
+        const char* field[5];
+        const char* fieldEnd[5];
+        int fields = 0;
+        const char* f = p;
+        for (const char* c = p; c <= lineEnd && fields < 5; c++) {
+            if (c == lineEnd || (*c == ',' && fields < 4)) {
+                field[fields] = f;
+                fieldEnd[fields] = c;
+                fields++;
+                f = c + 1;
+            }
+        }
+
+        const char* lineStart = p;
+        p = eol + 1;
+        if (lineEnd == lineStart) continue;
+
+        LoadedRow row;
+        row.line = line;
+        if (fields < 5) {
+            errors.push_back(LoadError{line, "expected 5 comma-separated fields"});
+            continue;
+        }
+        if (!parseDate(field[0], fieldEnd[0] - field[0], row.info.date)) {
+            errors.push_back(LoadError{line, "invalid date"});
+            continue;
+        }
+        if (!scanNumber(field[1], fieldEnd[1], 2, row.info.hour) || row.info.hour > 23) {
+            errors.push_back(LoadError{line, "invalid hour"});
+            continue;
+        }
+        if (!parseRoom(field[2], fieldEnd[2] - field[2], row.info.room)) {
+            errors.push_back(LoadError{line, "invalid room"});
+            continue;
+        }
+        row.info.lecturer = Names().intern(field[3], fieldEnd[3] - field[3]);
+        row.info.course = Names().intern(field[4], fieldEnd[4] - field[4]);
+        row.key = makeSlotKey(row.info.date, row.info.room, row.info.hour);
+
+        if (!rows.empty() && row.key <= rows.back().key)
+            sorted = false;
+        rows.push_back(row);
+    }
+    return sorted;
+}
+
+// Loads a bookings file into bookings, in slot order with no repeated slot,
+// ready for BuildIndex or BuildStore. The rows are sorted only if the file
+// is not already in slot order (the order SaveToFile writes). Returns the
+// number of bookings loaded.
+inline int BulkLoad(const char* path, vector<Booking>& bookings, vector<LoadError>& errors) {
+    MappedFile file;
+    if (!file.open(path)) return 0;
+
+    vector<LoadedRow> rows;
+    bool sorted = ScanBookings(file.data, file.size, rows, errors);
+    file.close();
+
+    if (!sorted) {
+        stable_sort(rows.begin(), rows.end(), [](const LoadedRow& a, const LoadedRow& b) {
+            return a.key < b.key;
+        });
+    }
+
+    size_t first = bookings.size();
+    bookings.reserve(first + rows.size());
+    for (size_t i = 0; i < rows.size(); i++) {
+        if (i > 0 && rows[i].key == rows[i - 1].key) {
+            errors.push_back(LoadError{rows[i].line, "slot already booked"});
+            continue;
+        }
+        bookings.push_back(rows[i].info);
+    }
+    return (int)(bookings.size() - first);
+}
+
+#endif
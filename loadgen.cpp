@@ -0,0 +1,265 @@
+// Load generator for `tree --serve`. For each thread count it runs that
+// many clients against the server for a fixed time and reports throughput
+// and latency percentiles. Clients mix searches and date reports with
+// bookings that race for the same slots of a date nobody else uses; a slot
+// that two clients both booked successfully is reported as a double
+// booking. The round's bookings are cancelled again afterwards.
+//
+//   loadgen [--socket path] [--threads 1,2,4,8] [--seconds 2] [--writes 10]
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <random>
+#include <algorithm>
+#include <cstring>
+#include <cstdlib>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "availability.hpp"
+using namespace std;
+
+// Every bookable slot of a day, as the server limits them.
+const int ROOMS = ROOM_COUNT;
+const int FIRST_HOUR = OPEN_HOUR;
+const int HOURS = CLOSE_HOUR - OPEN_HOUR;
+
+class Connection {
+    private:
+    int fd;
+    string input;
+
+    public:
+    Connection() {
+        fd = -1;
+    }
+
+    ~Connection() {
+        if (fd >= 0) ::close(fd);
+    }
+
+    bool open(const string& path) {
+        sockaddr_un addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+
+        fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        return fd >= 0 && connect(fd, (sockaddr*)&addr, sizeof(addr)) == 0;
+    }
+
+    // Sends one command and waits for its result line.
+    bool request(const string& command, string& reply) {
+        string line = command + "\n";
+        const char* p = line.data();
+        size_t left = line.size();
+        while (left > 0) {
+            int n = ::write(fd, p, left);
+            if (n <= 0) return false;
+            p += n;
+            left -= n;
+        }
+
+        size_t end;
+        char buffer[65536];
+        while ((end = input.find('\n')) == string::npos) {
+            int n = ::read(fd, buffer, sizeof(buffer));
+            if (n <= 0) return false;
+            input.append(buffer, n);
+        }
+        reply = input.substr(0, end);
+        input.erase(0, end + 1);
+        return true;
+    }
+};
+
+struct RoundResult {
+    long long operations;
+    long long failures;
+    double seconds;
+    double p50, p99, max;
+    int booked;
+    int doubleBooked;
+};
+
+string slotDate(int round) {
+    // 99-12-01 onwards: far enough out to be empty on a real timetable.
+    string date = "9912";
+    date += '0' + (round + 1) / 10;
+    date += '0' + (round + 1) % 10;
+    return date;
+}
+
+RoundResult RunRound(const string& path, int threads, double seconds, int writePercent, int round) {
+    string date = slotDate(round);
+    vector<atomic<int>> wins(ROOMS * HOURS);
+    for (size_t i = 0; i < wins.size(); i++)
+        wins[i] = 0;
+
+    vector<vector<double>> latencies(threads);
+    vector<long long> failures(threads, 0);
+    atomic<int> ready(0);
+    auto deadline = chrono::steady_clock::now() + chrono::milliseconds((long long)(seconds * 1000));
+
+    vector<thread> clients;
+    for (int t = 0; t < threads; t++) {
+        clients.push_back(thread([&, t]() {
+            Connection conn;
+            if (!conn.open(path)) {
+                failures[t]++;
+                ready++;
+                return;
+            }
+            mt19937 rng(round * 1000 + t);
+            string reply;
+            ready++;
+            while (ready < threads) this_thread::yield();
+
+            while (chrono::steady_clock::now() < deadline) {
+                int slot = rng() % (ROOMS * HOURS);
+                int room = slot / HOURS + 1;
+                int hour = slot % HOURS + FIRST_HOUR;
+                int pick = rng() % 100;
+
+                string command;
+                if (pick < writePercent)
+                    command = "book," + date + "," + to_string(hour) + ",1," + to_string(room)
+                            + ",loadgen,T" + to_string(t);
+                else if (pick < writePercent + 5)
+                    command = "report,date," + date;
+                else
+                    command = "search," + date + "," + to_string(hour) + "," + to_string(room);
+
+                auto start = chrono::steady_clock::now();
+                if (!conn.request(command, reply)) {
+                    failures[t]++;
+                    return;
+                }
+                latencies[t].push_back(chrono::duration<double, micro>(chrono::steady_clock::now() - start).count());
+
+                if (reply.find("\"status\":\"error\"") != string::npos)
+                    failures[t]++;
+                else if (pick < writePercent && reply.find("\"status\":\"ok\"") != string::npos)
+                    wins[slot]++;
+            }
+        }));
+    }
+    auto begin = chrono::steady_clock::now();
+    for (size_t i = 0; i < clients.size(); i++)
+        clients[i].join();
+
+    RoundResult r;
+    r.seconds = chrono::duration<double>(chrono::steady_clock::now() - begin).count();
+    vector<double> all;
+    r.failures = 0;
+    for (int t = 0; t < threads; t++) {
+        all.insert(all.end(), latencies[t].begin(), latencies[t].end());
+        r.failures += failures[t];
+    }
+    sort(all.begin(), all.end());
+    r.operations = all.size();
+    r.p50 = all.empty() ? 0 : all[all.size() / 2];
+    r.p99 = all.empty() ? 0 : all[min(all.size() - 1, all.size() * 99 / 100)];
+    r.max = all.empty() ? 0 : all.back();
+
+    r.booked = 0;
+    r.doubleBooked = 0;
+    Connection cleanup;
+    bool canClean = cleanup.open(path);
+    string reply;
+    for (int slot = 0; slot < ROOMS * HOURS; slot++) {
+        if (wins[slot] > 0) r.booked++;
+        if (wins[slot] > 1) r.doubleBooked++;
+        if (wins[slot] > 0 && canClean)
+            cleanup.request("cancel," + date + "," + to_string(slot % HOURS + FIRST_HOUR) + ",1,"
+                            + to_string(slot / HOURS + 1), reply);
+    }
+    return r;
+}
+
+// Whole-string numbers only, so a typo is an error rather than 0.
+bool parseNumber(const string& text, long& value) {
+    char* end;
+    value = strtol(text.c_str(), &end, 10);
+    return !text.empty() && *end == '\0';
+}
+
+bool parseNumber(const string& text, double& value) {
+    char* end;
+    value = strtod(text.c_str(), &end);
+    return !text.empty() && *end == '\0';
+}
+
+int Usage(const char* program) {
+    cerr << "Usage: " << program << " [--socket path] [--threads 1,2,4,8] [--seconds 2] [--writes 10]\n"
+         << "  --threads takes positive counts, --seconds a positive time and\n"
+         << "  --writes a percentage from 0 to 100\n";
+    return 1;
+}
+
+int main(int argc, char* argv[]) {
+    string path = "bookings.sock";
+    vector<int> threadCounts;
+    double seconds = 2;
+    int writePercent = 10;
+
+    // An unknown option or a bad value would otherwise run, and report,
+    // the default workload.
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if (i + 1 >= argc)
+            return Usage(argv[0]);
+
+        string value = argv[++i];
+        bool valid = true;
+        if (arg == "--socket") {
+            path = value;
+        } else if (arg == "--threads") {
+            size_t start = 0;
+            while (valid && start <= value.size()) {
+                size_t comma = value.find(',', start);
+                if (comma == string::npos) comma = value.size();
+                long count;
+                valid = parseNumber(value.substr(start, comma - start), count) && count >= 1 && count <= 1024;
+                threadCounts.push_back((int)count);
+                start = comma + 1;
+            }
+        } else if (arg == "--seconds") {
+            valid = parseNumber(value, seconds) && seconds > 0;
+        } else if (arg == "--writes") {
+            long percent;
+            valid = parseNumber(value, percent) && percent >= 0 && percent <= 100;
+            writePercent = (int)percent;
+        } else {
+            valid = false;
+        }
+
+        if (!valid)
+            return Usage(argv[0]);
+    }
+    if (threadCounts.empty()) {
+        int counts[] = {1, 2, 4, 8, 16};
+        threadCounts.assign(counts, counts + 5);
+    }
+
+    cout << "| Threads | Ops       | Ops/s     | p50 (us) | p99 (us) | Max (us) | Booked | Double | Errors |\n";
+    for (size_t i = 0; i < threadCounts.size(); i++) {
+        RoundResult r = RunRound(path, threadCounts[i], seconds, writePercent, (int)i);
+        cout << fixed << setprecision(0)
+             << "| " << setw(7) << threadCounts[i]
+             << " | " << setw(9) << r.operations
+             << " | " << setw(9) << r.operations / r.seconds
+             << " | " << setw(8) << r.p50
+             << " | " << setw(8) << r.p99
+             << " | " << setw(8) << r.max
+             << " | " << setw(6) << r.booked
+             << " | " << setw(6) << r.doubleBooked
+             << " | " << setw(6) << r.failures
+             << " |\n";
+    }
+    return 0;
+}
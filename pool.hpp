@@ -0,0 +1,115 @@
+#ifndef POOL_HPP
+#define POOL_HPP
+
+#include <cstddef>
+#include <new>
+#include <vector>
+using namespace std;
+
+// Fixed-size node allocator. Nodes are carved out of 64 KB slabs and freed
+// nodes go on a free list for reuse, so building a tree or a result stack
+// costs one malloc per slab instead of one per node. There is one pool per
+// node type; a type opts in with USE_NODE_POOL.
+template <class T>
+class NodePool {
+    private:
+    struct FreeNode {
+        FreeNode* next;
+    };
+
+    static const size_t NODE_SIZE = sizeof(T) > sizeof(FreeNode) ? sizeof(T) : sizeof(FreeNode);
+    static const size_t NODES_PER_SLAB = (65536 / NODE_SIZE) > 64 ? (65536 / NODE_SIZE) : 64;
+
+    vector<char*> slabs;
+    FreeNode* freeList;
+    size_t slabUsed;
+    size_t liveNodes;
+    size_t peakNodes;
+    size_t totalAllocations;
+    size_t reusedAllocations;
+
+    NodePool() {
+        freeList = NULL;
+        slabUsed = NODES_PER_SLAB;
+        liveNodes = 0;
+        peakNodes = 0;
+        totalAllocations = 0;
+        reusedAllocations = 0;
+    }
+
+    public:
+    struct Stats {
+        size_t nodeSize;
+        size_t live;
+        size_t peak;
+        size_t slabs;
+        size_t bytesReserved;
+        size_t allocations;
+        size_t reused;
+    };
+
+    // Never destroyed, so nodes owned by globals can still be freed at exit.
+    static NodePool& instance() {
+        static NodePool* pool = new NodePool();
+        return *pool;
+    }
+
+    void* allocate() {
+        totalAllocations++;
+        if (++liveNodes > peakNodes)
+            peakNodes = liveNodes;
+
+        if (freeList != NULL) {
+            FreeNode* node = freeList;
+            freeList = node->next;
+            reusedAllocations++;
+            return node;
+        }
+
+        if (slabUsed == NODES_PER_SLAB) {
+            slabs.push_back((char*)::operator new(NODE_SIZE * NODES_PER_SLAB));
+            slabUsed = 0;
+        }
+        return slabs.back() + NODE_SIZE * slabUsed++;
+    }
+
+    void deallocate(void* p) {
+        if (p == NULL) return;
+
+        FreeNode* node = (FreeNode*)p;
+        node->next = freeList;
+        freeList = node;
+        liveNodes--;
+    }
+
+    // Drops every node at once without running destructors. Only for types
+    // that are trivially destructible, or whose nodes were already destroyed.
+    void releaseAll() {
+        for (size_t i = 0; i < slabs.size(); i++)
+            ::operator delete(slabs[i]);
+        slabs.clear();
+        freeList = NULL;
+        slabUsed = NODES_PER_SLAB;
+        liveNodes = 0;
+    }
+
+    Stats stats() {
+        Stats s;
+        s.nodeSize = NODE_SIZE;
+        s.live = liveNodes;
+        s.peak = peakNodes;
+        s.slabs = slabs.size();
+        s.bytesReserved = slabs.size() * NODE_SIZE * NODES_PER_SLAB;
+        s.allocations = totalAllocations;
+        s.reused = reusedAllocations;
+        return s;
+    }
+};
+
+// Routes new/delete of a node type through its NodePool. Placed inside the
+// struct so aggregate initialisation (new TreeNode{...}) keeps working.
+#define USE_NODE_POOL(Type) \
+    static void* operator new(size_t) { return NodePool<Type>::instance().allocate(); } \
+    static void operator delete(void* p) { NodePool<Type>::instance().deallocate(p); }
+
+#endif
@@ -3,48 +3,80 @@
 
 #include <iostream>
 #include <string>
+#include <atomic>
+#include <thread>
+#include <utility>
+#include <new>
+#include "pool.hpp"
+#include "intern.hpp"
 using namespace std;
 
+// A booking is a small POD so copies are trivial. Text is kept elsewhere:
+// date is a day number (slotkey.hpp), lecturer and course are ids in the
+// name table (intern.hpp).
 struct Booking {
-    string date;
+    int date;
     int hour;
-    string room;
-    string lecturer;
-    string course;
+    int room;
+    int lecturer;
+    int course;
 };
 
-class nodeQueue {
+template <class T>
+class QueueNode {
     public:
-    char item;
-    nodeQueue *next;
+    T item;
+    QueueNode* next;
+
+    template <class... Args>
+    QueueNode(Args&&... args) : item(std::forward<Args>(args)...), next(NULL) {}
+
+    USE_NODE_POOL(QueueNode)
 };
 
+// Single-threaded FIFO queue of any type, a linked list of pooled nodes.
+// Items are moved or constructed in place on the way in and moved out on
+// the way out; the accessors return pointers into the queue (NULL when it
+// is empty), so looking at the front or rear copies nothing.
+template <class T>
 class Queue {
-    public:
-    nodeQueue *backPtr, *frontPtr;
+    private:
+    QueueNode<T> *backPtr, *frontPtr;
+    int count;
 
-    void createQueue() {
+    public:
+    Queue() {
         backPtr = NULL;
         frontPtr = NULL;
+        count = 0;
     }
 
+    ~Queue() {
+        destroyQueue();
+    }
+
+    Queue(const Queue&) = delete;
+    Queue& operator=(const Queue&) = delete;
+
     void destroyQueue() {
-        nodeQueue *temp = frontPtr;
+        QueueNode<T> *temp = frontPtr;
         while(temp) {
             frontPtr = temp->next;
             delete temp;
             temp = frontPtr;
         }
+        backPtr = NULL;
+        frontPtr = NULL;
+        count = 0;
     }
 
-    bool isEmpty() {
-        return (backPtr == NULL && frontPtr == NULL);
+    bool isEmpty() const {
+        return frontPtr == NULL;
     }
 
-    void enQueue(string value) {
-        nodeQueue *newNode = new nodeQueue;
-        newNode->item = value[0];
-        newNode->next = nullptr;
+    template <class... Args>
+    T& emplace(Args&&... args) {
+        QueueNode<T> *newNode = new QueueNode<T>(std::forward<Args>(args)...);
 
         if (backPtr == nullptr) {
             frontPtr = backPtr = newNode;
@@ -52,122 +84,370 @@ class Queue {
             backPtr->next = newNode;
             backPtr = newNode;
         }
+        count++;
+        return newNode->item;
     }
 
-    void deQueue() {
-        if (isEmpty()) {
-            cout << "Queue is already empty.\n";
-            return;
-        } else {
-            nodeQueue *temp = frontPtr;
-            frontPtr = frontPtr->next;
-            delete temp;
+    void enQueue(const T& value) {
+        emplace(value);
+    }
 
-            if (frontPtr == nullptr) {
-                backPtr = nullptr;
-            }
-        } 
+    void enQueue(T&& value) {
+        emplace(std::move(value));
     }
 
-    void getFront() {
-        if (isEmpty()) {
-            cout << "Queue is empty.\n";
-            return;
-        }
-        cout << frontPtr->item << endl;
+    // Moves the front item into item. False if the queue is empty.
+    bool deQueue(T& item) {
+        if (isEmpty()) return false;
+        item = std::move(frontPtr->item);
+        return deQueue();
     }
 
-    void getRear() {
-        if (isEmpty()) {
-            cout << "Queue is empty.\n";
-            return;
+    // Drops the front item. False if the queue is empty.
+    bool deQueue() {
+        if (isEmpty()) return false;
+
+        QueueNode<T> *temp = frontPtr;
+        frontPtr = frontPtr->next;
+        delete temp;
+        count--;
+
+        if (frontPtr == nullptr) {
+            backPtr = nullptr;
         }
-        cout << backPtr->item << endl;
+        return true;
+    }
+
+    T* getFront() {
+        return isEmpty() ? NULL : &frontPtr->item;
+    }
+
+    const T* getFront() const {
+        return isEmpty() ? NULL : &frontPtr->item;
+    }
+
+    T* getRear() {
+        return isEmpty() ? NULL : &backPtr->item;
+    }
+
+    const T* getRear() const {
+        return isEmpty() ? NULL : &backPtr->item;
+    }
+
+    int getSize() const {
+        return count;
+    }
+
+    // Visits the items front to back.
+    template <class Visit>
+    void forEach(Visit visit) const {
+        for (QueueNode<T>* node = frontPtr; node != NULL; node = node->next)
+            visit((const T&)node->item);
     }
 };
 
-class BookingNode {
+// The same interface as Queue, in one power-of-two ring buffer that
+// doubles when full. Pushes and pops are amortised O(1) with no allocation
+// per item, and forEach walks memory in order. A reference returned by
+// emplace, or a pointer from getFront/getRear, lasts until the next push.
+template <class T>
+class RingQueue {
+    private:
+    T* items;
+    size_t capacity;
+    size_t head;
+    size_t count;
+
+    T& at(size_t i) const {
+        return items[(head + i) & (capacity - 1)];
+    }
+
+    // Builds the new item in the bigger buffer before moving the old ones,
+    // so arguments that refer into the queue are still valid.
+    template <class... Args>
+    T& growAndEmplace(Args&&... args) {
+        size_t bigger = capacity == 0 ? 8 : capacity * 2;
+        T* moved = (T*)::operator new(bigger * sizeof(T));
+        T* item = new (moved + count) T(std::forward<Args>(args)...);
+
+        for (size_t i = 0; i < count; i++) {
+            new (moved + i) T(std::move(at(i)));
+            at(i).~T();
+        }
+        ::operator delete(items);
+        items = moved;
+        capacity = bigger;
+        head = 0;
+        count++;
+        return *item;
+    }
+
     public:
-    Booking* item;
-    BookingNode *next;
+    RingQueue() {
+        items = NULL;
+        capacity = 0;
+        head = 0;
+        count = 0;
+    }
+
+    ~RingQueue() {
+        destroyQueue();
+    }
+
+    RingQueue(const RingQueue&) = delete;
+    RingQueue& operator=(const RingQueue&) = delete;
+
+    // Empties the queue and frees its buffer.
+    void destroyQueue() {
+        while (deQueue()) {
+        }
+        ::operator delete(items);
+        items = NULL;
+        capacity = 0;
+        head = 0;
+    }
+
+    bool isEmpty() const {
+        return count == 0;
+    }
+
+    template <class... Args>
+    T& emplace(Args&&... args) {
+        if (count == capacity) return growAndEmplace(std::forward<Args>(args)...);
+        T* item = new (&at(count)) T(std::forward<Args>(args)...);
+        count++;
+        return *item;
+    }
+
+    void enQueue(const T& value) {
+        emplace(value);
+    }
+
+    void enQueue(T&& value) {
+        emplace(std::move(value));
+    }
+
+    bool deQueue(T& item) {
+        if (isEmpty()) return false;
+        item = std::move(at(0));
+        return deQueue();
+    }
+
+    bool deQueue() {
+        if (isEmpty()) return false;
+        at(0).~T();
+        head = (head + 1) & (capacity - 1);
+        count--;
+        return true;
+    }
+
+    T* getFront() {
+        return isEmpty() ? NULL : &at(0);
+    }
+
+    const T* getFront() const {
+        return isEmpty() ? NULL : &at(0);
+    }
+
+    T* getRear() {
+        return isEmpty() ? NULL : &at(count - 1);
+    }
+
+    const T* getRear() const {
+        return isEmpty() ? NULL : &at(count - 1);
+    }
+
+    int getSize() const {
+        return (int)count;
+    }
+
+    // Bytes held by the queue and its buffer.
+    size_t memoryUsage() const {
+        return sizeof(*this) + capacity * sizeof(T);
+    }
+
+    template <class Visit>
+    void forEach(Visit visit) const {
+        for (size_t i = 0; i < count; i++)
+            visit((const T&)at(i));
+    }
 };
 
-class WaitlistQueue {
+// Node of ConcurrentWaitlistQueue. Producers allocate these on their own
+// threads, so they come from the general heap rather than a NodePool.
+class WaitlistNode {
     public:
-    BookingNode *backPtr, *frontPtr;
+    Booking item;
+    atomic<WaitlistNode*> next;
+    // Set once the producer's record callback has run; see enQueue.
+    atomic<bool> recorded;
+};
 
-    void createQueue() {
-        backPtr = NULL;
-        frontPtr = NULL;
+// Lock-free multi-producer, single-consumer waitlist (Vyukov's intrusive
+// MPSC queue). Any number of threads may enQueue at once: each one swaps
+// itself in as the tail and then links the old tail to it, so the order of
+// the swaps is the FIFO order. Only one thread at a time may deQueue, which
+// is the cancellation path promoting the first waiting booking. head is a
+// stub node whose successor is the front of the queue.
+class ConcurrentWaitlistQueue {
+    private:
+    WaitlistNode* head;
+    atomic<WaitlistNode*> tail;
+    atomic<int> count;
+
+    public:
+    ConcurrentWaitlistQueue() {
+        head = new WaitlistNode;
+        head->next = NULL;
+        head->recorded = true;
+        tail = head;
+        count = 0;
     }
 
-    void destroyQueue() {
-        BookingNode *temp = frontPtr;
-        while(temp) {
-            frontPtr = temp->next;
-            delete temp->item;
-            delete temp;
-            temp = frontPtr;
+    ~ConcurrentWaitlistQueue() {
+        Booking b;
+        while (deQueue(b)) {
         }
-        backPtr = NULL;
-        frontPtr = NULL;
+        delete head;
     }
 
+    ConcurrentWaitlistQueue(const ConcurrentWaitlistQueue&) = delete;
+    ConcurrentWaitlistQueue& operator=(const ConcurrentWaitlistQueue&) = delete;
+
     bool isEmpty() {
-        return (backPtr == NULL && frontPtr == NULL);
+        return tail.load(memory_order_acquire) == head;
     }
 
-    void enQueue(Booking b) {
-        BookingNode *newNode = new BookingNode;
-        newNode->item = new Booking(b);
-        newNode->next = nullptr;
+    void enQueue(const Booking& b) {
+        enQueue(b, [](const Booking&) {});
+    }
 
-        if (backPtr == nullptr) {
-            frontPtr = backPtr = newNode;
-        } else {
-            backPtr->next = newNode;
-            backPtr = newNode;
-        }
+    // Queues b and calls record(b) once its place is fixed. Producers run
+    // record in queue order, each after the one ahead of it, so a journal
+    // written from it lists the queue as it is. The wait is for a producer
+    // that has swapped the tail but not finished record yet. b is linked
+    // only after record returns, so the consumer and forEach see recorded
+    // bookings only.
+    template <class Record>
+    void enQueue(const Booking& b, Record record) {
+        WaitlistNode* node = new WaitlistNode;
+        node->item = b;
+        node->next.store(NULL, memory_order_relaxed);
+        node->recorded.store(false, memory_order_relaxed);
+
+        count.fetch_add(1, memory_order_relaxed);
+        WaitlistNode* prev = tail.exchange(node, memory_order_acq_rel);
+        while (!prev->recorded.load(memory_order_acquire))
+            this_thread::yield();
+        record(node->item);
+        node->recorded.store(true, memory_order_release);
+        prev->next.store(node, memory_order_release);
     }
 
-    Booking* deQueue() {
-        if (isEmpty()) {
-            return nullptr;
-        } else {
-            BookingNode *temp = frontPtr;
-            Booking* booking = temp->item;
-            frontPtr = frontPtr->next;
-            delete temp;
+    // Consumer only. A producer that has swapped the tail but not yet linked
+    // its node is at most a record call from done, so wait for it rather
+    // than let a later booking overtake it.
+    bool deQueue(Booking& booking) {
+        WaitlistNode* next = head->next.load(memory_order_acquire);
+        while (next == NULL) {
+            if (tail.load(memory_order_acquire) == head) return false;
+            this_thread::yield();
+            next = head->next.load(memory_order_acquire);
+        }
 
-            if (frontPtr == nullptr) {
-                backPtr = nullptr;
-            }
-            return booking;
-        } 
+        booking = next->item;
+        delete head;
+        head = next;
+        count.fetch_sub(1, memory_order_relaxed);
+        return true;
     }
 
+    // The front booking, or NULL. Consumer only.
     Booking* getFront() {
-        if (isEmpty()) {
-            return nullptr;
-        }
-        return frontPtr->item;
+        WaitlistNode* next = head->next.load(memory_order_acquire);
+        return next == NULL ? NULL : &next->item;
     }
 
-    Booking* getRear() {
-        if (isEmpty()) {
-            return nullptr;
+    // O(1). While producers are running it may count a booking that
+    // deQueue cannot see yet.
+    int getSize() {
+        return count.load(memory_order_relaxed);
+    }
+
+    // Bytes held by the queue and its nodes, the stub included.
+    size_t memoryUsage() {
+        return sizeof(*this) + (getSize() + 1) * sizeof(WaitlistNode);
+    }
+
+    // Visits the linked bookings front to back. Safe alongside producers,
+    // which only ever add nodes past the ones it has seen, but not
+    // alongside the consumer.
+    template <class Visit>
+    void forEach(Visit visit) {
+        for (WaitlistNode* node = head->next.load(memory_order_acquire); node != NULL;
+             node = node->next.load(memory_order_acquire)) {
+            visit((const Booking&)node->item);
         }
-        return backPtr->item;
+    }
+};
+
+// One slot's waitlist, front first. WaitlistRegistry holds one per slot.
+// Joins go to arrivals, so any number may run at once. The consumer (the
+// cancellation path promoting the front) first moves the arrivals in order
+// to the back of waiting, a RingQueue it alone touches, so bookings that
+// wait on are kept contiguous and cost no node each. Every booking in
+// waiting joined before every one in arrivals, so walking waiting and then
+// arrivals is queue order.
+class WaitlistQueue {
+    private:
+    RingQueue<Booking> waiting;
+    ConcurrentWaitlistQueue arrivals;
+
+    void settle() {
+        Booking b;
+        while (arrivals.deQueue(b))
+            waiting.enQueue(b);
+    }
+
+    public:
+    bool isEmpty() {
+        return waiting.isEmpty() && arrivals.isEmpty();
+    }
+
+    void enQueue(const Booking& b) {
+        arrivals.enQueue(b);
+    }
+
+    // See ConcurrentWaitlistQueue::enQueue.
+    template <class Record>
+    void enQueue(const Booking& b, Record record) {
+        arrivals.enQueue(b, record);
+    }
+
+    // Consumer only.
+    bool deQueue(Booking& booking) {
+        settle();
+        return waiting.deQueue(booking);
+    }
+
+    // Consumer only.
+    Booking* getFront() {
+        return waiting.isEmpty() ? arrivals.getFront() : waiting.getFront();
     }
 
     int getSize() {
-        int count = 0;
-        BookingNode* temp = frontPtr;
-        while (temp) {
-            count++;
-            temp = temp->next;
-        }
-        return count;
+        return waiting.getSize() + arrivals.getSize();
+    }
+
+    size_t memoryUsage() {
+        return waiting.memoryUsage() + arrivals.memoryUsage();
+    }
+
+    // Safe alongside producers, not alongside the consumer.
+    template <class Visit>
+    void forEach(Visit visit) {
+        waiting.forEach(visit);
+        arrivals.forEach(visit);
     }
 
     void display() {
@@ -175,15 +455,13 @@ class WaitlistQueue {
             cout << "No one in waitlist.\n";
             return;
         }
-        
-        BookingNode* temp = frontPtr;
+
         int position = 1;
-        while (temp) {
-            cout << position << ". Lecturer: " << temp->item->lecturer 
-                 << " | Course: " << temp->item->course << "\n";
-            temp = temp->next;
+        forEach([&](const Booking& b) {
+            cout << position << ". Lecturer: " << Names().name(b.lecturer)
+                 << " | Course: " << Names().name(b.course) << "\n";
             position++;
-        }
+        });
     }
 };
 
@@ -0,0 +1,213 @@
+#ifndef REPORT_HPP
+#define REPORT_HPP
+
+#include <iostream>
+#include <string>
+#include "queue.hpp"
+#include "slotkey.hpp"
+#include "intern.hpp"
+using namespace std;
+
+// Formats report rows into one reusable buffer and writes it out in large
+// chunks, so a long report costs one write per REPORT_CHUNK bytes rather
+// than iostream formatting and a flush per row. Numbers, dates and padded
+// fields are formatted by hand.
+//
+// Table rows match the menu's schedule layout, CSV rows the bookings.txt
+// line format, and JSON rows the objects of commands.hpp, in one array.
+// With pageRows set, the report stops every pageRows rows and waits for
+// Enter on pager; 'q' ends it early.
+enum ReportFormat { REPORT_TABLE, REPORT_CSV, REPORT_JSON };
+
+const size_t REPORT_CHUNK = 1 << 16;
+
+// Writes value in decimal to the end of text[24] and returns where it
+// starts.
+inline char* formatInt(char* text, long long value) {
+    char* p = text + 24;
+    unsigned long long v = value < 0 ? 0 - (unsigned long long)value : value;
+    do {
+        *--p = '0' + v % 10;
+        v /= 10;
+    } while (v != 0);
+    if (value < 0) *--p = '-';
+    return p;
+}
+
+inline void appendInt(string& out, long long value) {
+    char text[24];
+    char* start = formatInt(text, value);
+    out.append(start, text + 24 - start);
+}
+
+// Right-aligns text in width columns, as setw does; longer text is kept
+// whole.
+inline void appendPadded(string& out, const char* text, size_t len, size_t width) {
+    if (len < width) out.append(width - len, ' ');
+    out.append(text, len);
+}
+
+inline void appendPadded(string& out, const string& text, size_t width) {
+    appendPadded(out, text.data(), text.size(), width);
+}
+
+inline void appendPaddedInt(string& out, long long value, size_t width) {
+    char text[24];
+    char* start = formatInt(text, value);
+    appendPadded(out, start, text + 24 - start, width);
+}
+
+// YYMMDD, like formatDate, without a temporary string.
+inline void appendDate(string& out, int day) {
+    int y, m, d;
+    civilFromDays(day, y, m, d);
+    char date[6] = {
+        (char)('0' + (y / 10) % 10), (char)('0' + y % 10),
+        (char)('0' + m / 10),        (char)('0' + m % 10),
+        (char)('0' + d / 10),        (char)('0' + d % 10)
+    };
+    out.append(date, 6);
+}
+
+inline void appendJsonString(string& out, const string& s) {
+    static const char hex[] = "0123456789abcdef";
+    out += '"';
+    for (size_t i = 0; i < s.size(); i++) {
+        unsigned char c = s[i];
+        if (c == '"' || c == '\\') {
+            out += '\\';
+            out += c;
+        } else if (c < 0x20) {
+            out += "\\u00";
+            out += hex[c >> 4];
+            out += hex[c & 15];
+        } else {
+            out += c;
+        }
+    }
+    out += '"';
+}
+
+inline void appendJsonBooking(string& out, const Booking& b) {
+    out += "{\"date\":\"";
+    appendDate(out, b.date);
+    out += "\",\"hour\":";
+    appendInt(out, b.hour);
+    out += ",\"room\":";
+    appendInt(out, b.room);
+    out += ",\"lecturer\":";
+    appendJsonString(out, Names().name(b.lecturer));
+    out += ",\"course\":";
+    appendJsonString(out, Names().name(b.course));
+    out += '}';
+}
+
+inline void appendCsvBooking(string& out, const Booking& b) {
+    appendDate(out, b.date);
+    out += ',';
+    appendInt(out, b.hour);
+    out += ',';
+    appendInt(out, b.room);
+    out += ',';
+    out += Names().name(b.lecturer);
+    out += ',';
+    out += Names().name(b.course);
+    out += '\n';
+}
+
+inline void appendTableBooking(string& out, const Booking& b) {
+    out += "| ";
+    appendDate(out, b.date);
+    out += " | ";
+    appendPaddedInt(out, b.hour, 2);
+    out += ":00 | ";
+    appendPaddedInt(out, b.room, 6);
+    out += " | ";
+    appendPadded(out, Names().name(b.lecturer), 12);
+    out += " | ";
+    appendPadded(out, Names().name(b.course), 10);
+    out += " |\n";
+}
+
+class ReportWriter {
+    private:
+    ostream& out;
+    ReportFormat format;
+    size_t pageRows;
+    istream* pager;
+    string buffer;
+    size_t rows;
+    bool stopped;
+    bool finished;
+
+    void flushBuffer() {
+        if (!buffer.empty()) out.write(buffer.data(), buffer.size());
+        buffer.clear();
+    }
+
+    // Shows the page so far and waits; false if the reader quit.
+    bool nextPage() {
+        flushBuffer();
+        out << "-- " << rows << " rows, Enter for more, q to stop -- ";
+        out.flush();
+
+        string answer;
+        if (!getline(*pager, answer) || (!answer.empty() && (answer[0] == 'q' || answer[0] == 'Q')))
+            return false;
+        return true;
+    }
+
+    public:
+    ReportWriter(ostream& output, ReportFormat f, size_t rowsPerPage = 0, istream* input = NULL)
+        : out(output) {
+        format = f;
+        pageRows = input != NULL ? rowsPerPage : 0;
+        pager = input;
+        rows = 0;
+        stopped = false;
+        finished = false;
+        buffer.reserve(REPORT_CHUNK + 256);
+        if (format == REPORT_JSON) buffer += '[';
+    }
+
+    ~ReportWriter() {
+        finish();
+    }
+
+    // Adds one row. Returns false once the reader has stopped the report;
+    // later rows are dropped.
+    bool add(const Booking& b) {
+        if (stopped || finished) return false;
+        if (pageRows > 0 && rows > 0 && rows % pageRows == 0 && !nextPage()) {
+            stopped = true;
+            return false;
+        }
+
+        if (format == REPORT_TABLE) {
+            appendTableBooking(buffer, b);
+        } else if (format == REPORT_CSV) {
+            appendCsvBooking(buffer, b);
+        } else {
+            if (rows > 0) buffer += ',';
+            appendJsonBooking(buffer, b);
+        }
+        rows++;
+        if (buffer.size() >= REPORT_CHUNK) flushBuffer();
+        return true;
+    }
+
+    size_t count() {
+        return rows;
+    }
+
+    // Closes a JSON array and writes what is buffered. Called by the
+    // destructor if not before.
+    void finish() {
+        if (finished) return;
+        if (format == REPORT_JSON) buffer += "]\n";
+        flushBuffer();
+        finished = true;
+    }
+};
+
+#endif
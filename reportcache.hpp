@@ -0,0 +1,146 @@
+#ifndef REPORTCACHE_HPP
+#define REPORTCACHE_HPP
+
+#include <cstdint>
+#include <mutex>
+#include <vector>
+#include "queue.hpp"
+#include "store.hpp"
+using namespace std;
+
+// Results of recent date and room schedules, so a report asked for again
+// is copied from memory instead of walking the trees. An entry remembers
+// the store's epoch when it was filled; it is served while the date's (or
+// room's) change stamp is no later than that and the store has not been
+// cleared since. Stale entries are refilled in place. At most
+// REPORT_CACHE_ENTRIES are kept; the least recently used one makes room.
+//
+// Readers may look up and fill entries concurrently (the server holds the
+// engine lock shared for reports), so the cache has its own lock; stamps
+// only change under the engine lock held exclusively.
+const size_t REPORT_CACHE_ENTRIES = 64;
+
+enum ReportQuery { QUERY_DATE, QUERY_ROOM };
+
+struct ReportCacheStats {
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t stale;
+    uint64_t evictions;
+    uint64_t entries;
+    uint64_t rows;
+    uint64_t bytes;
+};
+
+class ReportCache {
+    private:
+    struct Entry {
+        ReportQuery query;
+        int id;
+        int fromDay;
+        int toDay;
+        uint64_t epoch;
+        uint64_t lastUse;
+        vector<Booking> rows;
+    };
+
+    vector<Entry*> entries;
+    uint64_t ticks;
+    ReportCacheStats counts;
+    mutex lock;
+
+    Entry* find(ReportQuery query, int id, int fromDay, int toDay) {
+        for (size_t i = 0; i < entries.size(); i++) {
+            Entry* e = entries[i];
+            if (e->query == query && e->id == id && e->fromDay == fromDay && e->toDay == toDay)
+                return e;
+        }
+        return NULL;
+    }
+
+    static uint64_t stampOf(BookingStore& store, ReportQuery query, int id) {
+        return query == QUERY_DATE ? store.dateStamp(id) : store.roomStamp(id);
+    }
+
+    public:
+    ReportCache() {
+        ticks = 0;
+        counts = ReportCacheStats();
+    }
+
+    ~ReportCache() {
+        clear();
+    }
+
+    // Copies the cached rows of the query into rows and returns true if
+    // they are still current.
+    bool lookup(BookingStore& store, ReportQuery query, int id, int fromDay, int toDay,
+                vector<Booking>& rows) {
+        lock_guard<mutex> held(lock);
+        Entry* e = find(query, id, fromDay, toDay);
+        if (e == NULL) {
+            counts.misses++;
+            return false;
+        }
+        if (e->epoch < store.clearEpoch() || stampOf(store, query, id) > e->epoch) {
+            counts.misses++;
+            counts.stale++;
+            return false;
+        }
+        e->lastUse = ++ticks;
+        rows.insert(rows.end(), e->rows.begin(), e->rows.end());
+        counts.hits++;
+        return true;
+    }
+
+    // Stores rows as the result of the query at epoch, the store's epoch
+    // read before they were collected.
+    void store(ReportQuery query, int id, int fromDay, int toDay, uint64_t epoch,
+               const vector<Booking>& rows) {
+        lock_guard<mutex> held(lock);
+        Entry* e = find(query, id, fromDay, toDay);
+        if (e == NULL) {
+            if (entries.size() >= REPORT_CACHE_ENTRIES) {
+                size_t oldest = 0;
+                for (size_t i = 1; i < entries.size(); i++) {
+                    if (entries[i]->lastUse < entries[oldest]->lastUse)
+                        oldest = i;
+                }
+                delete entries[oldest];
+                entries.erase(entries.begin() + oldest);
+                counts.evictions++;
+            }
+            e = new Entry();
+            e->query = query;
+            e->id = id;
+            e->fromDay = fromDay;
+            e->toDay = toDay;
+            entries.push_back(e);
+        }
+        e->epoch = epoch;
+        e->lastUse = ++ticks;
+        e->rows = rows;
+    }
+
+    void clear() {
+        lock_guard<mutex> held(lock);
+        for (size_t i = 0; i < entries.size(); i++)
+            delete entries[i];
+        entries.clear();
+    }
+
+    ReportCacheStats stats() {
+        lock_guard<mutex> held(lock);
+        ReportCacheStats s = counts;
+        s.entries = entries.size();
+        s.rows = 0;
+        s.bytes = 0;
+        for (size_t i = 0; i < entries.size(); i++) {
+            s.rows += entries[i]->rows.size();
+            s.bytes += sizeof(Entry) + entries[i]->rows.capacity() * sizeof(Booking);
+        }
+        return s;
+    }
+};
+
+#endif
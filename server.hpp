@@ -0,0 +1,196 @@
+#ifndef SERVER_HPP
+#define SERVER_HPP
+
+#ifndef _WIN32
+#include <string>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <shared_mutex>
+#include <condition_variable>
+#include <atomic>
+#include <csignal>
+#include <cstring>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "tree.hpp"
+#include "booking.hpp"
+#include "commands.hpp"
+using namespace std;
+
+// Local booking server. Clients connect to a Unix socket and send command
+// lines (see commands.hpp); every non-blank line gets its JSON result line
+// back, in order. Each connection has its own thread. Searches, waitlist
+// views and reports hold the engine lock shared and run in parallel;
+// bookings and cancellations hold it exclusively, so two clients can never
+// be handed the same slot, and hand their changes to the journal before
+// releasing it. A waitlisted booking whose block is taken only queues, so
+// it also holds the lock shared: many clients joining a popular slot at
+// once feed its lock-free queue side by side, and a cancellation, which
+// promotes the front, waits for them. The reply waits for the journal
+// outside the lock: in sync and group modes every "ok" or "waitlisted" a
+// client sees is already durable, and in group mode writers that arrive
+// during an fsync share the next one. Readers may still load an archived
+// shard; LoadShard serialises that itself.
+const char* const SERVER_SOCKET = "bookings.sock";
+
+class BookingServer {
+    private:
+    BookingStore& store;
+    shared_mutex engineLock;
+    int listenFd;
+    string socketPath;
+
+    mutex clientsLock;
+    condition_variable clientsDone;
+    vector<int> clientFds;
+
+    static atomic<bool>& stopFlag() {
+        static atomic<bool> flag(false);
+        return flag;
+    }
+
+    static void onSignal(int) {
+        stopFlag() = true;
+    }
+
+    CommandOutcome execute(const string& line, int lineNo, string& out) {
+        if (IsReadOnlyCommand(line)) {
+            shared_lock<shared_mutex> lock(engineLock);
+            return ExecuteCommand(store, line, lineNo, out);
+        }
+
+        CommandOutcome outcome;
+        uint64_t ticket;
+        if (MayJoinWaitlist(line)) {
+            // Compaction waits for the next exclusive write: it writes the
+            // queues out, and a join logged meanwhile could be lost.
+            {
+                shared_lock<shared_mutex> lock(engineLock);
+                outcome = ExecuteCommand(store, line, lineNo, out, true);
+                ticket = journal.submit();
+            }
+            if (outcome != COMMAND_EXCLUSIVE) {
+                journal.waitDurable(ticket);
+                return outcome;
+            }
+        }
+
+        {
+            unique_lock<shared_mutex> lock(engineLock);
+            outcome = ExecuteCommand(store, line, lineNo, out);
+            ticket = SubmitChanges(store);
+        }
+        journal.waitDurable(ticket);
+        return outcome;
+    }
+
+    // Answers every complete line of each read with a single write, so
+    // pipelined clients cost one syscall per batch rather than per command.
+    void serveClient(int fd) {
+        char buffer[65536];
+        string input, out;
+        int lineNo = 0;
+
+        while (true) {
+            int n = ::read(fd, buffer, sizeof(buffer));
+            if (n <= 0) break;
+            input.append(buffer, n);
+
+            size_t start = 0, end;
+            while ((end = input.find('\n', start)) != string::npos) {
+                execute(input.substr(start, end - start), ++lineNo, out);
+                start = end + 1;
+            }
+            input.erase(0, start);
+
+            if (!out.empty() && !writeAll(fd, out.data(), out.size())) break;
+            out.clear();
+        }
+
+        lock_guard<mutex> lock(clientsLock);
+        for (size_t i = 0; i < clientFds.size(); i++) {
+            if (clientFds[i] == fd) {
+                clientFds.erase(clientFds.begin() + i);
+                break;
+            }
+        }
+        ::close(fd);
+        clientsDone.notify_all();
+    }
+
+    public:
+    BookingServer(BookingStore& bookingStore) : store(bookingStore) {
+        listenFd = -1;
+    }
+
+    ~BookingServer() {
+        if (listenFd >= 0) {
+            ::close(listenFd);
+            unlink(socketPath.c_str());
+        }
+    }
+
+    bool listen(const char* path, string& error) {
+        sockaddr_un addr;
+        if (strlen(path) >= sizeof(addr.sun_path)) {
+            error = "socket path too long";
+            return false;
+        }
+        memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        strcpy(addr.sun_path, path);
+
+        listenFd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (listenFd < 0) {
+            error = "cannot create socket";
+            return false;
+        }
+        unlink(path);
+        if (::bind(listenFd, (sockaddr*)&addr, sizeof(addr)) != 0 || ::listen(listenFd, 128) != 0) {
+            error = "cannot listen on socket";
+            ::close(listenFd);
+            listenFd = -1;
+            return false;
+        }
+        socketPath = path;
+        return true;
+    }
+
+    // Serves until SIGINT or SIGTERM, then closes every connection and
+    // waits for the client threads to finish.
+    void run() {
+        stopFlag() = false;
+        signal(SIGINT, onSignal);
+        signal(SIGTERM, onSignal);
+        signal(SIGPIPE, SIG_IGN);
+
+        // Readers must never build the shards themselves.
+        Materialize(store);
+
+        while (!stopFlag()) {
+            pollfd p;
+            p.fd = listenFd;
+            p.events = POLLIN;
+            if (poll(&p, 1, 200) <= 0) continue;
+
+            int fd = accept(listenFd, NULL, NULL);
+            if (fd < 0) continue;
+
+            lock_guard<mutex> lock(clientsLock);
+            clientFds.push_back(fd);
+            thread(&BookingServer::serveClient, this, fd).detach();
+        }
+
+        unique_lock<mutex> lock(clientsLock);
+        for (size_t i = 0; i < clientFds.size(); i++)
+            shutdown(clientFds[i], SHUT_RDWR);
+        clientsDone.wait(lock, [this]() { return clientFds.empty(); });
+    }
+};
+
+#endif
+
+#endif
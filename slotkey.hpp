@@ -0,0 +1,140 @@
+#ifndef SLOTKEY_HPP
+#define SLOTKEY_HPP
+
+#include <cstddef>
+#include <string>
+#include "queue.hpp"
+#include "intern.hpp"
+using namespace std;
+
+// A booking slot packed into one integer: day number in the high bits, then
+// room, then hour. Keys order by date, then room, then hour, so the hours of
+// one room on one day sit next to each other in the index.
+typedef unsigned long long SlotKey;
+
+const int SLOT_ROOM_BITS = 16;
+const int SLOT_HOUR_BITS = 8;
+
+inline SlotKey makeSlotKey(int day, int room, int hour) {
+    return ((SlotKey)day << (SLOT_ROOM_BITS + SLOT_HOUR_BITS))
+         | ((SlotKey)room << SLOT_HOUR_BITS)
+         | (SlotKey)hour;
+}
+
+inline int slotDay(SlotKey key) {
+    return (int)(key >> (SLOT_ROOM_BITS + SLOT_HOUR_BITS));
+}
+
+inline int slotRoom(SlotKey key) {
+    return (int)((key >> SLOT_HOUR_BITS) & ((1 << SLOT_ROOM_BITS) - 1));
+}
+
+inline int slotHour(SlotKey key) {
+    return (int)(key & ((1 << SLOT_HOUR_BITS) - 1));
+}
+
+// Day numbers count days since 2000-01-01 (civil calendar, see
+// http://howardhinnant.github.io/date_algorithms.html).
+inline int daysFromCivil(int y, int m, int d) {
+    y -= m <= 2;
+    int era = y / 400;
+    int yoe = y - era * 400;
+    int doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+    int doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return era * 146097 + doe - 730425;
+}
+
+inline void civilFromDays(int day, int& y, int& m, int& d) {
+    int z = day + 730425;
+    int era = z / 146097;
+    int doe = z - era * 146097;
+    int yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+    int doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+    int mp = (5 * doy + 2) / 153;
+    d = doy - (153 * mp + 2) / 5 + 1;
+    m = mp < 10 ? mp + 3 : mp - 9;
+    y = yoe + era * 400 + (m <= 2);
+}
+
+inline int daysInMonth(int y, int m) {
+    static const int days[] = {31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
+    bool leap = (y % 4 == 0 && y % 100 != 0) || y % 400 == 0;
+    return (m == 2 && leap) ? 29 : days[m - 1];
+}
+
+// Parses a YYMMDD date into a day number. Rejects dates that do not exist.
+inline bool parseDate(const char* date, size_t len, int& day) {
+    if (len != 6) return false;
+    for (size_t i = 0; i < len; i++)
+        if (date[i] < '0' || date[i] > '9') return false;
+
+    int y = 2000 + (date[0] - '0') * 10 + (date[1] - '0');
+    int m = (date[2] - '0') * 10 + (date[3] - '0');
+    int d = (date[4] - '0') * 10 + (date[5] - '0');
+
+    if (m < 1 || m > 12 || d < 1 || d > daysInMonth(y, m)) return false;
+
+    day = daysFromCivil(y, m, d);
+    return true;
+}
+
+inline bool parseDate(const string& date, int& day) {
+    return parseDate(date.data(), date.size(), day);
+}
+
+inline string formatDate(int day) {
+    int y, m, d;
+    civilFromDays(day, y, m, d);
+
+    string date = "000000";
+    date[0] = '0' + (y / 10) % 10; date[1] = '0' + y % 10;
+    date[2] = '0' + m / 10;        date[3] = '0' + m % 10;
+    date[4] = '0' + d / 10;        date[5] = '0' + d % 10;
+    return date;
+}
+
+inline bool parseRoom(const char* room, size_t len, int& id) {
+    if (len == 0 || len > 5) return false;
+
+    id = 0;
+    for (size_t i = 0; i < len; i++) {
+        if (room[i] < '0' || room[i] > '9') return false;
+        id = id * 10 + (room[i] - '0');
+    }
+    return id >= 1 && id < (1 << SLOT_ROOM_BITS);
+}
+
+inline bool parseRoom(const string& room, int& id) {
+    return parseRoom(room.data(), room.size(), id);
+}
+
+inline bool makeKey(const string& date, int hour, const string& room, SlotKey& key) {
+    int day, roomId;
+    if (!parseDate(date, day) || !parseRoom(room, roomId)) return false;
+    if (hour < 0 || hour > 23) return false;
+
+    key = makeSlotKey(day, roomId, hour);
+    return true;
+}
+
+inline bool makeKey(const Booking& b, SlotKey& key) {
+    if (b.date < 0 || b.room < 1 || b.room >= (1 << SLOT_ROOM_BITS)) return false;
+    if (b.hour < 0 || b.hour > 23) return false;
+
+    key = makeSlotKey(b.date, b.room, b.hour);
+    return true;
+}
+
+// Builds a booking from its text fields, interning the names.
+inline bool makeBooking(const string& date, int hour, const string& room,
+                        const string& lecturer, const string& course, Booking& b) {
+    if (!parseDate(date, b.date) || !parseRoom(room, b.room)) return false;
+    if (hour < 0 || hour > 23) return false;
+
+    b.hour = hour;
+    b.lecturer = Names().intern(lecturer);
+    b.course = Names().intern(course);
+    return true;
+}
+
+#endif
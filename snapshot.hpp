@@ -0,0 +1,243 @@
+#ifndef SNAPSHOT_HPP
+#define SNAPSHOT_HPP
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+#include "queue.hpp"
+#include "slotkey.hpp"
+#include "intern.hpp"
+#include "tree.hpp"
+#include "loader.hpp"
+using namespace std;
+
+// Binary snapshot, an alternative to bookings.txt:
+//
+//   SnapshotHeader
+//   SnapshotRecord[recordCount]      sorted by slot key
+//   uint32_t offsets[stringCount+1]  string table: name i is
+//   char bytes[stringBytes]          bytes[offsets[i] .. offsets[i+1])
+//
+// Integers are stored in host byte order. checksum is FNV-1a over
+// everything after the header. Records are fixed width and sorted, so a
+// mapped file can answer lookups by binary search without being parsed.
+const char* const SNAPSHOT_BIN_FILE = "bookings.bin";
+const uint32_t SNAPSHOT_VERSION = 1;
+const char SNAPSHOT_MAGIC[8] = {'B', 'K', 'S', 'N', 'A', 'P', '\r', '\n'};
+
+struct SnapshotHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t recordSize;
+    uint64_t recordCount;
+    uint64_t stringCount;
+    uint64_t stringBytes;
+    uint64_t checksum;
+};
+
+struct SnapshotRecord {
+    uint64_t key;
+    uint32_t lecturer;
+    uint32_t course;
+};
+
+inline uint64_t fnv1a(const char* data, size_t len) {
+    uint64_t h = 14695981039346656037ULL;
+    for (size_t i = 0; i < len; i++) {
+        h ^= (unsigned char)data[i];
+        h *= 1099511628211ULL;
+    }
+    return h;
+}
+
+// Serialises bookings, in slot order, into snapshot bytes. Only names used
+// by bookings go into the string table.
+inline string EncodeSnapshot(const vector<Booking>& sorted) {
+    vector<int> fileId(Names().size(), -1);
+    vector<int> usedNames;
+    vector<SnapshotRecord> records;
+    records.reserve(sorted.size());
+
+    for (size_t i = 0; i < sorted.size(); i++) {
+        const Booking& b = sorted[i];
+        int ids[2] = {b.lecturer, b.course};
+        for (int k = 0; k < 2; k++) {
+            if (fileId[ids[k]] < 0) {
+                fileId[ids[k]] = (int)usedNames.size();
+                usedNames.push_back(ids[k]);
+            }
+        }
+        SnapshotRecord r;
+        r.key = makeSlotKey(b.date, b.room, b.hour);
+        r.lecturer = fileId[ids[0]];
+        r.course = fileId[ids[1]];
+        records.push_back(r);
+    }
+
+    vector<uint32_t> offsets(usedNames.size() + 1, 0);
+    string bytes;
+    for (size_t i = 0; i < usedNames.size(); i++) {
+        bytes += Names().name(usedNames[i]);
+        offsets[i + 1] = (uint32_t)bytes.size();
+    }
+
+    string body;
+    body.append((const char*)records.data(), records.size() * sizeof(SnapshotRecord));
+    body.append((const char*)offsets.data(), offsets.size() * sizeof(uint32_t));
+    body += bytes;
+
+    SnapshotHeader header;
+    memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic));
+    header.version = SNAPSHOT_VERSION;
+    header.recordSize = sizeof(SnapshotRecord);
+    header.recordCount = records.size();
+    header.stringCount = usedNames.size();
+    header.stringBytes = bytes.size();
+    header.checksum = fnv1a(body.data(), body.size());
+
+    return string((const char*)&header, sizeof(header)) + body;
+}
+
+inline string EncodeSnapshot(BookingIndex& index) {
+    vector<Booking> rows;
+    rows.reserve(index.count);
+    for (TreeNode* node = First(index.root); node != NULL; node = Successor(node))
+        rows.push_back(node->info);
+    return EncodeSnapshot(rows);
+}
+
+// A snapshot file mapped read-only. Lookups binary-search the mapped record
+// array; the only work done when opening is the checksum and interning the
+// string table.
+class SnapshotView {
+    private:
+    MappedFile file;
+    const SnapshotRecord* records;
+    size_t count;
+    vector<int> names;
+
+    public:
+    SnapshotView() {
+        records = NULL;
+        count = 0;
+    }
+
+    bool open(const char* path, string& error) {
+        close();
+        error.clear();
+        if (!file.open(path)) {
+            error = "cannot open file";
+            return false;
+        }
+
+        SnapshotHeader header;
+        if (file.size < sizeof(header)) {
+            error = "file too short";
+            close();
+            return false;
+        }
+        memcpy(&header, file.data, sizeof(header));
+
+        if (memcmp(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic)) != 0) {
+            error = "not a booking snapshot";
+        } else if (header.version != SNAPSHOT_VERSION || header.recordSize != sizeof(SnapshotRecord)) {
+            error = "unsupported snapshot version " + to_string(header.version);
+        } else if (file.size != sizeof(header) + header.recordCount * sizeof(SnapshotRecord)
+                                + (header.stringCount + 1) * sizeof(uint32_t) + header.stringBytes) {
+            error = "truncated snapshot";
+        } else if (fnv1a(file.data + sizeof(header), file.size - sizeof(header)) != header.checksum) {
+            error = "checksum mismatch";
+        }
+        if (!error.empty()) {
+            close();
+            return false;
+        }
+
+        records = (const SnapshotRecord*)(file.data + sizeof(header));
+        count = header.recordCount;
+
+        const char* table = (const char*)(records + count);
+        uint32_t offsets[2];
+        const char* bytes = table + (header.stringCount + 1) * sizeof(uint32_t);
+        names.resize(header.stringCount);
+        for (size_t i = 0; i < header.stringCount; i++) {
+            memcpy(offsets, table + i * sizeof(uint32_t), sizeof(offsets));
+            if (offsets[0] > offsets[1] || offsets[1] > header.stringBytes) {
+                error = "corrupt string table";
+                close();
+                return false;
+            }
+            names[i] = Names().intern(bytes + offsets[0], offsets[1] - offsets[0]);
+        }
+        for (size_t i = 0; i < count; i++) {
+            if (records[i].lecturer >= names.size() || records[i].course >= names.size() ||
+                (i > 0 && records[i].key <= records[i - 1].key)) {
+                error = "corrupt record " + to_string(i);
+                close();
+                return false;
+            }
+        }
+        return true;
+    }
+
+    void close() {
+        file.close();
+        records = NULL;
+        count = 0;
+        names.clear();
+    }
+
+    bool isOpen() {
+        return records != NULL;
+    }
+
+    size_t size() {
+        return count;
+    }
+
+    SlotKey keyAt(size_t i) {
+        return records[i].key;
+    }
+
+    Booking bookingAt(size_t i) {
+        Booking b;
+        SlotKey key = records[i].key;
+        b.date = slotDay(key);
+        b.room = slotRoom(key);
+        b.hour = slotHour(key);
+        b.lecturer = names[records[i].lecturer];
+        b.course = names[records[i].course];
+        return b;
+    }
+
+    // Index of the first record whose key is >= key.
+    size_t lowerBound(SlotKey key) {
+        size_t lo = 0, hi = count;
+        while (lo < hi) {
+            size_t mid = lo + (hi - lo) / 2;
+            if (records[mid].key < key)
+                lo = mid + 1;
+            else
+                hi = mid;
+        }
+        return lo;
+    }
+
+    bool find(SlotKey key, Booking& result) {
+        size_t i = lowerBound(key);
+        if (i == count || records[i].key != key) return false;
+
+        result = bookingAt(i);
+        return true;
+    }
+
+    // Copies every booking out, in slot order, for BuildIndex.
+    void copyTo(vector<Booking>& rows) {
+        rows.reserve(rows.size() + count);
+        for (size_t i = 0; i < count; i++)
+            rows.push_back(bookingAt(i));
+    }
+};
+
+#endif
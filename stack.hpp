@@ -1,34 +1,47 @@
 #ifndef STACK_HPP
 #define STACK_HPP
 
-#include <iostream>
-#include <string>
-#include "queue.hpp"
+#include <vector>
+#include <utility>
+#include "pool.hpp"
 using namespace std;
 
-class BookingNode_Stack {
+template <class T>
+class StackNode {
     public:
-    Booking item;
-    BookingNode_Stack* next;
+    T item;
+    StackNode* next;
+
+    template <class... Args>
+    StackNode(Args&&... args) : item(std::forward<Args>(args)...), next(NULL) {}
+
+    USE_NODE_POOL(StackNode)
 };
 
-class BookingStack {
+// LIFO stack of any type, a linked list of pooled nodes. Like Queue, items
+// go in by move or in-place construction, come out by move, and peek
+// returns a pointer to the top item (NULL when empty).
+template <class T>
+class Stack {
     private:
-    BookingNode_Stack* topPtr;
+    StackNode<T>* topPtr;
     int count;
 
     public:
-    BookingStack() {
+    Stack() {
         topPtr = NULL;
         count = 0;
     }
 
-    ~BookingStack() {
+    ~Stack() {
         destroyStack();
     }
 
+    Stack(const Stack&) = delete;
+    Stack& operator=(const Stack&) = delete;
+
     void destroyStack() {
-        BookingNode_Stack* temp;
+        StackNode<T>* temp;
         while (topPtr != NULL) {
             temp = topPtr;
             topPtr = topPtr->next;
@@ -37,60 +50,67 @@ class BookingStack {
         count = 0;
     }
 
-    bool isEmpty() {
+    bool isEmpty() const {
         return (topPtr == NULL);
     }
 
-    void push(Booking b) {
-        BookingNode_Stack* newNode = new BookingNode_Stack;
-        newNode->item = b;
+    template <class... Args>
+    T& emplace(Args&&... args) {
+        StackNode<T>* newNode = new StackNode<T>(std::forward<Args>(args)...);
         newNode->next = topPtr;
         topPtr = newNode;
         count++;
+        return newNode->item;
     }
 
-    Booking pop() {
-        if (isEmpty()) {
-            cout << "Stack is empty!\n";
-            return Booking(); 
-        }
-        
-        BookingNode_Stack* temp = topPtr;
-        Booking booking = temp->item;
+    void push(const T& value) {
+        emplace(value);
+    }
+
+    void push(T&& value) {
+        emplace(std::move(value));
+    }
+
+    // Moves the top item into item. False if the stack is empty.
+    bool pop(T& item) {
+        if (isEmpty()) return false;
+        item = std::move(topPtr->item);
+        return pop();
+    }
+
+    // Drops the top item. False if the stack is empty.
+    bool pop() {
+        if (isEmpty()) return false;
+
+        StackNode<T>* temp = topPtr;
         topPtr = topPtr->next;
         delete temp;
         count--;
-        return booking;
+        return true;
     }
 
-    Booking peek() {
-        if (isEmpty()) {
-            cout << "Stack is empty!\n";
-            return Booking();
-        }
-        return topPtr->item;
+    T* peek() {
+        return isEmpty() ? NULL : &topPtr->item;
     }
 
-    int size() {
+    const T* peek() const {
+        return isEmpty() ? NULL : &topPtr->item;
+    }
+
+    int size() const {
         return count;
     }
 
-    void display() {
-        if (isEmpty()) {
-            cout << "No booking history.\n";
-            return;
-        }
+    // Visits the items oldest first, the order they were pushed in.
+    template <class Visit>
+    void forEach(Visit visit) const {
+        vector<const StackNode<T>*> nodes;
+        nodes.reserve(count);
+        for (const StackNode<T>* temp = topPtr; temp != NULL; temp = temp->next)
+            nodes.push_back(temp);
 
-        BookingNode_Stack* temp = topPtr;
-        while (temp != NULL) {
-            cout << "| " << setw(6) << temp->item.date
-                 << " | " << setw(2) << temp->item.hour << ":00"
-                 << " | " << setw(6) << temp->item.room
-                 << " | " << setw(12) << temp->item.lecturer
-                 << " | " << setw(10) << temp->item.course
-                 << " |\n";
-            temp = temp->next;
-        }
+        for (size_t i = nodes.size(); i > 0; i--)
+            visit(nodes[i - 1]->item);
     }
 };
 
@@ -0,0 +1,199 @@
+#ifndef STATS_HPP
+#define STATS_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+using namespace std;
+
+// Counters and latency histograms for the engine's hot paths: index
+// operations, persistence and waitlist promotion. Updates are relaxed
+// atomic adds, so server threads can record concurrently. Reading the clock
+// costs about as much as a tree lookup, so the index operations time only
+// one call in LATENCY_SAMPLE_EVERY of each histogram's calls; every call is
+// still counted.
+// Building with -DBOOKING_NO_STATS compiles every STAT_* macro to nothing.
+
+// Bucket i counts samples of [2^i, 2^(i+1)) nanoseconds; bucket 0 also
+// takes 0 and the last one everything longer.
+const int LATENCY_BUCKETS = 40;
+const uint32_t LATENCY_SAMPLE_EVERY = 16;
+
+inline int highestBit(uint64_t bits) {
+#ifdef _MSC_VER
+    unsigned long i;
+    _BitScanReverse64(&i, bits);
+    return (int)i;
+#else
+    return 63 - __builtin_clzll(bits);
+#endif
+}
+
+inline void raiseTo(atomic<uint64_t>& target, uint64_t value) {
+    uint64_t current = target.load(memory_order_relaxed);
+    while (value > current &&
+           !target.compare_exchange_weak(current, value, memory_order_relaxed)) {}
+}
+
+class LatencyHistogram {
+    private:
+    uint32_t sampleEvery;
+    atomic<uint64_t> calls;
+    atomic<uint64_t> buckets[LATENCY_BUCKETS];
+    atomic<uint64_t> samples;
+    atomic<uint64_t> totalNs;
+    atomic<uint64_t> maxNs;
+
+    public:
+    // sampleEvery must be a power of two.
+    LatencyHistogram(uint32_t every = 1) {
+        sampleEvery = every;
+        calls = 0;
+        for (int i = 0; i < LATENCY_BUCKETS; i++)
+            buckets[i] = 0;
+        samples = 0;
+        totalNs = 0;
+        maxNs = 0;
+    }
+
+    // Counts a call and says whether to time it. The phase is this
+    // histogram's own, so operations that alternate in a fixed pattern
+    // are each still sampled.
+    bool sample() {
+        return (calls.fetch_add(1, memory_order_relaxed) & (sampleEvery - 1)) == 0;
+    }
+
+    void record(uint64_t ns) {
+        int bucket = ns == 0 ? 0 : min(highestBit(ns), LATENCY_BUCKETS - 1);
+        buckets[bucket].fetch_add(1, memory_order_relaxed);
+        samples.fetch_add(1, memory_order_relaxed);
+        totalNs.fetch_add(ns, memory_order_relaxed);
+        raiseTo(maxNs, ns);
+    }
+
+    uint64_t count() {
+        return calls.load(memory_order_relaxed);
+    }
+
+    uint64_t sampled() {
+        return samples.load(memory_order_relaxed);
+    }
+
+    uint64_t meanNs() {
+        uint64_t n = samples.load(memory_order_relaxed);
+        return n == 0 ? 0 : totalNs.load(memory_order_relaxed) / n;
+    }
+
+    uint64_t maximumNs() {
+        return maxNs.load(memory_order_relaxed);
+    }
+
+    // Upper bound of the bucket holding the p-th percentile sample.
+    uint64_t percentileNs(double p) {
+        uint64_t n = samples.load(memory_order_relaxed);
+        if (n == 0) return 0;
+
+        uint64_t rank = (uint64_t)(p / 100 * n);
+        uint64_t seen = 0;
+        for (int i = 0; i < LATENCY_BUCKETS; i++) {
+            seen += buckets[i].load(memory_order_relaxed);
+            if (seen > rank) return (2ULL << i) - 1;
+        }
+        return maximumNs();
+    }
+};
+
+struct EngineStats {
+    LatencyHistogram insert;
+    LatencyHistogram search;
+    LatencyHistogram remove;
+    LatencyHistogram load;
+    LatencyHistogram rewrite;
+    LatencyHistogram commit;
+    LatencyHistogram compaction;
+    LatencyHistogram promote;
+
+    // Descents through the booking trees and the nodes they visited.
+    atomic<uint64_t> treeLookups;
+    atomic<uint64_t> treeSteps;
+
+    atomic<uint64_t> waitlistJoins;
+    atomic<uint64_t> promotions;
+    atomic<uint64_t> longestWaitlist;
+
+    EngineStats()
+        : insert(LATENCY_SAMPLE_EVERY), search(LATENCY_SAMPLE_EVERY), remove(LATENCY_SAMPLE_EVERY) {
+        treeLookups = 0;
+        treeSteps = 0;
+        waitlistJoins = 0;
+        promotions = 0;
+        longestWaitlist = 0;
+    }
+};
+
+// The process-wide statistics. Never destroyed, like Names().
+inline EngineStats& Stats() {
+    static EngineStats* stats = new EngineStats();
+    return *stats;
+}
+
+inline uint64_t nanosSince(chrono::steady_clock::time_point start) {
+    return chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - start).count();
+}
+
+// Counts a call and, if it is sampled, records the time from construction
+// to the end of the enclosing scope.
+class LatencyTimer {
+    private:
+    LatencyHistogram& histogram;
+    bool timed;
+    chrono::steady_clock::time_point start;
+
+    public:
+    LatencyTimer(LatencyHistogram& h) : histogram(h) {
+        timed = h.sample();
+        if (timed) start = chrono::steady_clock::now();
+    }
+
+    ~LatencyTimer() {
+        if (timed) histogram.record(nanosSince(start));
+    }
+};
+
+// One line of a stats dump.
+struct StatValue {
+    string name;
+    uint64_t value;
+};
+
+inline void appendHistogram(vector<StatValue>& values, const string& name, LatencyHistogram& h) {
+    values.push_back({name + "_count", h.count()});
+    values.push_back({name + "_mean_ns", h.meanNs()});
+    values.push_back({name + "_p50_ns", h.percentileNs(50)});
+    values.push_back({name + "_p99_ns", h.percentileNs(99)});
+    values.push_back({name + "_max_ns", h.maximumNs()});
+}
+
+#ifndef BOOKING_NO_STATS
+const bool STATS_ENABLED = true;
+#define STAT_TIMER(name) LatencyTimer statTimer_##name(Stats().name)
+#define STAT_CLOCK(var) chrono::steady_clock::time_point var = chrono::steady_clock::now()
+#define STAT_SINCE(name, var) (Stats().name.sample(), Stats().name.record(nanosSince(var)))
+#define STAT_ADD(name, n) Stats().name.fetch_add((n), memory_order_relaxed)
+#define STAT_MAX(name, v) raiseTo(Stats().name, (v))
+#else
+const bool STATS_ENABLED = false;
+#define STAT_TIMER(name) ((void)0)
+#define STAT_CLOCK(var) ((void)0)
+#define STAT_SINCE(name, var) ((void)0)
+#define STAT_ADD(name, n) ((void)(n))
+#define STAT_MAX(name, v) ((void)(v))
+#endif
+
+#endif
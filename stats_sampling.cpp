@@ -0,0 +1,51 @@
+// Checks that latency sampling does not starve an operation. Inserts and
+// searches alternate one for one, a pattern that lines up with the
+// sampling interval, and afterwards both histograms must have counted
+// every call and timed one in LATENCY_SAMPLE_EVERY of them.
+//
+//   stats_sampling [pairs]
+#include <iostream>
+#include <cstdlib>
+#include "booking.hpp"
+using namespace std;
+
+bool Check(const char* name, LatencyHistogram& h, uint64_t calls) {
+    uint64_t expected = (calls + LATENCY_SAMPLE_EVERY - 1) / LATENCY_SAMPLE_EVERY;
+    if (h.count() != calls || h.sampled() != expected) {
+        cerr << name << ": " << h.count() << " calls, " << h.sampled() << " sampled; expected "
+             << calls << " and " << expected << "\n";
+        return false;
+    }
+    return true;
+}
+
+int main(int argc, char* argv[]) {
+    int pairs = argc > 1 ? atoi(argv[1]) : 4000;
+    if (!STATS_ENABLED) {
+        cout << "stats compiled out, nothing to check\n";
+        return 0;
+    }
+
+    int firstDay = 0;
+    parseDate("260105", firstDay);
+
+    BookingStore store;
+    for (int i = 0; i < pairs; i++) {
+        Booking b;
+        b.date = firstDay + i / (ROOM_COUNT * (CLOSE_HOUR - OPEN_HOUR));
+        b.room = 1 + i % ROOM_COUNT;
+        b.hour = OPEN_HOUR + i / ROOM_COUNT % (CLOSE_HOUR - OPEN_HOUR);
+        b.lecturer = 0;
+        b.course = 0;
+        Insert(store, b);
+
+        Booking found;
+        FindBooking(store, makeSlotKey(b.date, b.room, b.hour), found);
+    }
+
+    bool ok = Check("insert", Stats().insert, pairs) & Check("search", Stats().search, pairs);
+    store.clear();
+
+    cout << (ok ? "passed" : "FAILED") << " (" << pairs << " alternating inserts and searches)\n";
+    return ok ? 0 : 1;
+}
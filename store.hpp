@@ -0,0 +1,529 @@
+#ifndef STORE_HPP
+#define STORE_HPP
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <mutex>
+#include <atomic>
+#include "queue.hpp"
+#include "slotkey.hpp"
+#include "tree.hpp"
+#include "waitlist.hpp"
+#include "journal.hpp"
+#include "snapshot.hpp"
+#include "threadpool.hpp"
+#include "availability.hpp"
+#ifdef _WIN32
+#include <direct.h>
+#define mkdir(path, mode) _mkdir(path)
+#else
+#include <sys/stat.h>
+#endif
+using namespace std;
+
+// The booking store is partitioned by week (Monday to Sunday) into shards,
+// each with its own index, waitlists and occupancy bitmaps. A date's queries, and every book
+// or cancel, touch exactly one shard; whole-store reports fan out across
+// the shards on the worker pool and concatenate the results, which are
+// already in order because shards are kept sorted by week.
+//
+// A shard whose week is over can be archived: written to
+// archive/week-N.bin in the snapshot format, dropped from memory and loaded
+// again the first time something reads it. Archived shards are read-only.
+// archive/weeks.txt lists the archived weeks.
+const char* const ARCHIVE_DIR = "archive";
+const char* const ARCHIVE_MANIFEST = "archive/weeks.txt";
+
+// Day 2 (2000-01-03) is a Monday.
+inline int weekOf(int day) {
+    return (day + 5) / 7;
+}
+
+inline int lastDayOfWeek(int week) {
+    return week * 7 + 1;
+}
+
+inline string archivePath(int week) {
+    return string(ARCHIVE_DIR) + "/week-" + to_string(week) + ".bin";
+}
+
+struct Shard {
+    int week;
+    BookingIndex index;
+    WaitlistRegistry waitlists;
+    WeekOccupancy occupancy;
+    bool archived;
+    atomic<bool> loaded;
+    // Change stamp of each day of the week, Monday first.
+    uint64_t dayStamps[7];
+};
+
+class BookingStore {
+    private:
+    vector<Shard*> shards;
+
+    // Change stamps for cached reports (reportcache.hpp). Each change to a
+    // slot takes a new epoch and stamps its date and room with it, so a
+    // report cached at some epoch is still right while neither stamp has
+    // passed it. clear() moves clearedAt up to invalidate everything.
+    uint64_t epoch;
+    uint64_t clearedAt;
+    vector<uint64_t> roomStamps;
+
+    public:
+    // Every booking of the writable shards by room and date, for checking
+    // a weekly series in one pass.
+    RoomCalendar calendar;
+
+    BookingStore() {
+        epoch = 0;
+        clearedAt = 0;
+    }
+
+    ~BookingStore() {
+        clear();
+    }
+
+    // Position of the first shard whose week is >= week.
+    size_t lowerBound(int week) {
+        size_t lo = 0, hi = shards.size();
+        while (lo < hi) {
+            size_t mid = lo + (hi - lo) / 2;
+            if (shards[mid]->week < week)
+                lo = mid + 1;
+            else
+                hi = mid;
+        }
+        return lo;
+    }
+
+    Shard* find(int week) {
+        size_t i = lowerBound(week);
+        return (i < shards.size() && shards[i]->week == week) ? shards[i] : NULL;
+    }
+
+    // Returns the shard for week, creating an empty one if needed.
+    Shard* get(int week) {
+        size_t i = lowerBound(week);
+        if (i < shards.size() && shards[i]->week == week)
+            return shards[i];
+
+        Shard* shard = new Shard();
+        shard->week = week;
+        shard->archived = false;
+        shard->loaded = true;
+        for (int d = 0; d < 7; d++)
+            shard->dayStamps[d] = 0;
+        shards.insert(shards.begin() + i, shard);
+        return shard;
+    }
+
+    size_t size() {
+        return shards.size();
+    }
+
+    Shard* at(size_t i) {
+        return shards[i];
+    }
+
+    // Bookings in memory; archived shards count once loaded.
+    int count() {
+        int total = 0;
+        for (size_t i = 0; i < shards.size(); i++)
+            total += shards[i]->index.count;
+        return total;
+    }
+
+    size_t waitlistCount() {
+        size_t total = 0;
+        for (size_t i = 0; i < shards.size(); i++)
+            total += shards[i]->waitlists.size();
+        return total;
+    }
+
+    void clearWaitlists() {
+        for (size_t i = 0; i < shards.size(); i++)
+            shards[i]->waitlists.clear();
+    }
+
+    size_t waitlistMemory() {
+        size_t total = 0;
+        for (size_t i = 0; i < shards.size(); i++)
+            total += shards[i]->waitlists.memoryUsage();
+        return total;
+    }
+
+    // Frees every shard. When the store owns all live tree nodes the pools
+    // are dropped in bulk, as DestroyIndex does for a single index.
+    void clear() {
+        bool bulk = NodePool<TreeNode>::instance().stats().live == (size_t)count() &&
+                    NodePool<RoomNode>::instance().stats().live == (size_t)count();
+        for (size_t i = 0; i < shards.size(); i++) {
+            if (bulk) {
+                shards[i]->index = BookingIndex();
+            } else {
+                DestroyTree(shards[i]->index.byRoom);
+                DestroyTree(shards[i]->index.root);
+            }
+            delete shards[i];
+        }
+        if (bulk) {
+            NodePool<TreeNode>::instance().releaseAll();
+            NodePool<RoomNode>::instance().releaseAll();
+        }
+        shards.clear();
+        calendar.clear();
+        clearedAt = ++epoch;
+    }
+
+    // Records a change to room on day, a day of shard's week.
+    void touch(Shard* shard, int day, int room) {
+        epoch++;
+        shard->dayStamps[day - (lastDayOfWeek(shard->week) - 6)] = epoch;
+        if ((size_t)room >= roomStamps.size()) roomStamps.resize(room + 1, 0);
+        roomStamps[room] = epoch;
+    }
+
+    uint64_t currentEpoch() {
+        return epoch;
+    }
+
+    uint64_t clearEpoch() {
+        return clearedAt;
+    }
+
+    uint64_t dateStamp(int day) {
+        Shard* shard = find(weekOf(day));
+        return shard == NULL ? 0 : shard->dayStamps[day - (lastDayOfWeek(shard->week) - 6)];
+    }
+
+    uint64_t roomStamp(int room) {
+        return (size_t)room < roomStamps.size() ? roomStamps[room] : 0;
+    }
+
+    // Registers the weeks listed in the archive manifest as archived,
+    // unloaded shards.
+    void loadManifest() {
+        ifstream in(ARCHIVE_MANIFEST);
+        int week;
+        while (in >> week) {
+            Shard* shard = get(week);
+            shard->archived = true;
+            shard->loaded = false;
+        }
+    }
+
+    bool saveManifest() {
+        string text;
+        for (size_t i = 0; i < shards.size(); i++) {
+            if (shards[i]->archived)
+                text += to_string(shards[i]->week) + "\n";
+        }
+        return writeFileAtomic(ARCHIVE_MANIFEST, text);
+    }
+};
+
+// Builds an archived shard's index from its file the first time it is
+// needed. Loads are serialised, since they allocate from the node pools and
+// intern names, so readers holding the engine lock shared may call this.
+inline bool LoadShard(Shard* shard) {
+    if (shard->loaded.load(memory_order_acquire)) return true;
+
+    static mutex loadLock;
+    lock_guard<mutex> held(loadLock);
+    if (shard->loaded.load(memory_order_acquire)) return true;
+
+    SnapshotView view;
+    string error;
+    if (!view.open(archivePath(shard->week).c_str(), error)) {
+        cerr << archivePath(shard->week) << ": " << error << "\n";
+        return false;
+    }
+    vector<Booking> rows;
+    view.copyTo(rows);
+    BuildIndex(shard->index, rows);
+    for (size_t i = 0; i < rows.size(); i++)
+        shard->occupancy.set(rows[i]);
+    shard->loaded.store(true, memory_order_release);
+    return true;
+}
+
+// Writes a shard to its archive file. It stays in memory until UnloadShard.
+inline bool WriteArchive(Shard* shard) {
+    mkdir(ARCHIVE_DIR, 0755);
+    return writeFileAtomic(archivePath(shard->week), EncodeSnapshot(shard->index));
+}
+
+// Frees an archived shard's index; LoadShard brings it back on demand.
+// The caller drops its week from the store's calendar.
+inline void UnloadShard(Shard* shard) {
+    DestroyTree(shard->index.byRoom);
+    DestroyTree(shard->index.root);
+    shard->index.count = 0;
+    shard->occupancy.clear();
+    shard->loaded = false;
+}
+
+inline bool IsArchived(BookingStore& store, int day) {
+    Shard* shard = store.find(weekOf(day));
+    return shard != NULL && shard->archived;
+}
+
+// The shard that may be changed for day: NULL if it is archived.
+inline Shard* WritableShard(BookingStore& store, int day) {
+    Shard* shard = store.get(weekOf(day));
+    return shard->archived ? NULL : shard;
+}
+
+// The shard holding day, loaded, or NULL if there is none.
+inline Shard* ReadableShard(BookingStore& store, int day) {
+    Shard* shard = store.find(weekOf(day));
+    return (shard != NULL && LoadShard(shard)) ? shard : NULL;
+}
+
+// The store-level Insert/Delete/InsertBlock/DeleteBlock keep each
+// shard's occupancy bitmaps and the store's calendar in step with its
+// index, and stamp the changed date and room for the report cache.
+// Inserts and deletes, single or block, are timed in Stats(); searches are
+// timed in FindBooking, which also answers from the mapped snapshot.
+inline bool Insert(BookingStore& store, Booking b) {
+    STAT_TIMER(insert);
+    Shard* shard = WritableShard(store, b.date);
+    if (shard == NULL || !Insert(shard->index, b)) return false;
+
+    shard->occupancy.set(b);
+    store.calendar.set(b.room, b.date, b.hour);
+    store.touch(shard, b.date, b.room);
+    return true;
+}
+
+inline bool Search(BookingStore& store, SlotKey key, Booking& result) {
+    Shard* shard = ReadableShard(store, slotDay(key));
+    return shard != NULL && Search(shard->index, key, result);
+}
+
+inline bool Delete(BookingStore& store, SlotKey key) {
+    STAT_TIMER(remove);
+    Shard* shard = store.find(weekOf(slotDay(key)));
+    if (shard == NULL || shard->archived || !Delete(shard->index, key)) return false;
+
+    shard->occupancy.get(slotDay(key))->reset(slotRoom(key), slotHour(key));
+    store.calendar.reset(slotRoom(key), slotDay(key), slotHour(key));
+    store.touch(shard, slotDay(key), slotRoom(key));
+    return true;
+}
+
+inline bool InsertBlock(BookingStore& store, Booking b, int duration) {
+    STAT_TIMER(insert);
+    Shard* shard = WritableShard(store, b.date);
+    if (shard == NULL || !InsertBlock(shard->index, b, duration)) return false;
+
+    DayOccupancy* day = shard->occupancy.get(b.date);
+    for (int i = 0; i < duration; i++) {
+        day->set(b.room, b.hour + i);
+        store.calendar.set(b.room, b.date, b.hour + i);
+    }
+    store.touch(shard, b.date, b.room);
+    return true;
+}
+
+inline int DeleteBlock(BookingStore& store, int day, int room, int startHour, int duration,
+                       vector<Booking>& removed) {
+    STAT_TIMER(remove);
+    Shard* shard = store.find(weekOf(day));
+    if (shard == NULL || shard->archived) return 0;
+
+    size_t first = removed.size();
+    int count = DeleteBlock(shard->index, day, room, startHour, duration, removed);
+    for (size_t i = first; i < removed.size(); i++) {
+        shard->occupancy.reset(removed[i]);
+        store.calendar.reset(removed[i].room, removed[i].date, removed[i].hour);
+    }
+    if (count > 0) store.touch(shard, day, room);
+    return count;
+}
+
+// Fills an empty store from bookings in slot-key order: each week's run of
+// rows becomes one shard built in O(n). Rows of archived weeks are dropped;
+// the archive file is authoritative for them.
+inline void BuildStore(BookingStore& store, const vector<Booking>& sorted) {
+    size_t start = 0;
+    vector<Booking> week;
+    while (start < sorted.size()) {
+        int w = weekOf(sorted[start].date);
+        size_t end = start;
+        while (end < sorted.size() && weekOf(sorted[end].date) == w)
+            end++;
+
+        Shard* shard = store.get(w);
+        if (!shard->archived && shard->index.count == 0) {
+            week.assign(sorted.begin() + start, sorted.begin() + end);
+            BuildIndex(shard->index, week);
+            for (size_t i = start; i < end; i++) {
+                shard->occupancy.set(sorted[i]);
+                store.calendar.set(sorted[i].room, sorted[i].date, sorted[i].hour);
+            }
+        }
+        start = end;
+    }
+}
+
+// The occupancy of day for queries: NULL if nothing was ever booked on it.
+// Sets archived if the day's week is archived (and so cannot be booked).
+inline DayOccupancy* OccupancyOf(BookingStore& store, int day, bool& archived) {
+    Shard* shard = store.find(weekOf(day));
+    archived = shard != NULL && shard->archived;
+    return (shard != NULL && !archived) ? shard->occupancy.find(day) : NULL;
+}
+
+inline bool blockFits(int startHour, int duration) {
+    return duration >= 1 && startHour >= OPEN_HOUR && startHour + duration <= CLOSE_HOUR;
+}
+
+// True if any hour of the block is booked.
+inline bool BlockTaken(BookingStore& store, int day, int room, int startHour, int duration) {
+    bool archived;
+    DayOccupancy* occupancy = OccupancyOf(store, day, archived);
+    if (occupancy == NULL || !blockFits(startHour, duration)) return false;
+
+    uint32_t block = ((1u << duration) - 1) << startHour;
+    return (occupancy->hoursOf(room) & block) != 0;
+}
+
+// The rooms free for duration hours from startHour on day, ascending.
+inline void FreeRooms(BookingStore& store, int day, int startHour, int duration, vector<int>& rooms) {
+    bool archived;
+    DayOccupancy* occupancy = OccupancyOf(store, day, archived);
+    if (archived || !blockFits(startHour, duration)) return;
+
+    if (occupancy == NULL) {
+        for (int r = 1; r <= ROOM_COUNT; r++)
+            rooms.push_back(r);
+        return;
+    }
+    occupancy->freeRooms(startHour, duration, ROOM_COUNT, rooms);
+}
+
+// The earliest block of duration free hours on day, in the lowest room
+// free at that time. False if there is none.
+inline bool FirstFreeBlock(BookingStore& store, int day, int duration, int& room, int& startHour) {
+    bool archived;
+    DayOccupancy* occupancy = OccupancyOf(store, day, archived);
+    if (archived) return false;
+
+    for (int h = OPEN_HOUR; blockFits(h, duration); h++) {
+        room = occupancy == NULL ? 1 : occupancy->firstFreeRoom(h, duration, ROOM_COUNT);
+        if (room != 0) {
+            startHour = h;
+            return true;
+        }
+    }
+    return false;
+}
+
+const int NEAREST_SLOT_DAYS = 14;
+
+// The free block closest to the requested one: nearest date first (later
+// before earlier), then nearest start hour (later before earlier). At each
+// date and hour the requested room is preferred, otherwise the lowest free
+// room is taken. Searches NEAREST_SLOT_DAYS either side of day.
+inline bool NearestFreeSlot(BookingStore& store, int day, int room, int startHour, int duration,
+                            Booking& found) {
+    if (duration < 1 || duration > CLOSE_HOUR - OPEN_HOUR) return false;
+
+    for (int offset = 0; offset <= NEAREST_SLOT_DAYS; offset++) {
+        for (int side = 0; side < (offset == 0 ? 1 : 2); side++) {
+            int d = side == 0 ? day + offset : day - offset;
+            bool archived = false;
+            DayOccupancy* occupancy = d >= 0 ? OccupancyOf(store, d, archived) : NULL;
+            if (d < 0 || archived) continue;
+
+            // Free start hours for the requested room, then for any room.
+            uint32_t busy = occupancy == NULL ? 0 : occupancy->hoursOf(room);
+            uint32_t own = blockStarts(~busy & OPEN_HOURS_MASK, duration);
+            for (int delta = 0; delta < CLOSE_HOUR - OPEN_HOUR; delta++) {
+                for (int dir = 0; dir < (delta == 0 ? 1 : 2); dir++) {
+                    int h = dir == 0 ? startHour + delta : startHour - delta;
+                    if (!blockFits(h, duration)) continue;
+
+                    int r = (own >> h) & 1 ? room
+                          : occupancy == NULL ? 1 : occupancy->firstFreeRoom(h, duration, ROOM_COUNT);
+                    if (r != 0) {
+                        found.date = d;
+                        found.hour = h;
+                        found.room = r;
+                        return true;
+                    }
+                }
+            }
+        }
+    }
+    return false;
+}
+
+// Runs collect(shard, rows) for the shards at positions [first, last) on
+// the worker pool and appends the results to rows in shard order.
+template <class Collect>
+void FanOut(BookingStore& store, size_t first, size_t last, Collect collect, vector<Booking>& rows) {
+    if (first >= last) return;
+
+    vector<vector<Booking>> parts(last - first);
+    Workers().parallelFor(last - first, [&](size_t i) {
+        Shard* shard = store.at(first + i);
+        if (LoadShard(shard))
+            collect(shard, parts[i]);
+    });
+
+    size_t total = rows.size();
+    for (size_t i = 0; i < parts.size(); i++)
+        total += parts[i].size();
+    rows.reserve(total);
+    for (size_t i = 0; i < parts.size(); i++)
+        rows.insert(rows.end(), parts[i].begin(), parts[i].end());
+}
+
+// Every booking, archived weeks included, in slot order.
+inline void CollectAll(BookingStore& store, vector<Booking>& rows) {
+    FanOut(store, 0, store.size(), [](Shard* shard, vector<Booking>& part) {
+        part.reserve(shard->index.count);
+        part.insert(part.end(), AllBookings(shard->index).begin(), AllBookings(shard->index).end());
+    }, rows);
+}
+
+// Every booking that filter accepts, in slot order.
+template <class Filter>
+void CollectMatching(BookingStore& store, Filter filter, vector<Booking>& rows) {
+    FanOut(store, 0, store.size(), [&](Shard* shard, vector<Booking>& part) {
+        for (const Booking& b : AllBookings(shard->index)) {
+            if (filter(b)) part.push_back(b);
+        }
+    }, rows);
+}
+
+// Bookings of one room between fromDay and toDay, inclusive, in date order.
+inline void CollectRoom(BookingStore& store, int room, int fromDay, int toDay, vector<Booking>& rows) {
+    size_t first = store.lowerBound(weekOf(fromDay));
+    size_t last = store.lowerBound(weekOf(toDay) + 1);
+
+    FanOut(store, first, last, [&](Shard* shard, vector<Booking>& part) {
+        BookingRange<RoomNode> range = RoomRange(shard->index, room, fromDay, toDay);
+        part.insert(part.end(), range.begin(), range.end());
+    }, rows);
+}
+
+// Streams the same bookings as CollectRoom to visit, one shard after
+// another on the calling thread, until visit returns false.
+template <class Visit>
+bool VisitRoom(BookingStore& store, int room, int fromDay, int toDay, Visit visit) {
+    size_t last = store.lowerBound(weekOf(toDay) + 1);
+    for (size_t i = store.lowerBound(weekOf(fromDay)); i < last; i++) {
+        Shard* shard = store.at(i);
+        if (LoadShard(shard) && !VisitRange(RoomRange(shard->index, room, fromDay, toDay), visit))
+            return false;
+    }
+    return true;
+}
+
+#endif
@@ -0,0 +1,116 @@
+#ifndef THREADPOOL_HPP
+#define THREADPOOL_HPP
+
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <vector>
+using namespace std;
+
+// Fixed set of worker threads for fan-out work. parallelFor hands out the
+// items of one call one at a time to whichever thread is free, including
+// the caller, so several callers (server connections) can share the pool.
+class ThreadPool {
+    private:
+    struct Job {
+        const function<void(size_t)>* task;
+        size_t count;
+        size_t next;
+        size_t remaining;
+    };
+
+    vector<thread> workers;
+    deque<Job*> jobs;
+    mutex lock;
+    condition_variable ready;
+    condition_variable done;
+    bool stopping;
+
+    // Takes the next item of job, with lock held.
+    bool claim(Job* job, size_t& item) {
+        if (job->next == job->count) return false;
+
+        item = job->next++;
+        if (job->next == job->count) {
+            for (size_t i = 0; i < jobs.size(); i++) {
+                if (jobs[i] == job) {
+                    jobs.erase(jobs.begin() + i);
+                    break;
+                }
+            }
+        }
+        return true;
+    }
+
+    void run(Job* job, size_t item, unique_lock<mutex>& held) {
+        held.unlock();
+        (*job->task)(item);
+        held.lock();
+        if (--job->remaining == 0)
+            done.notify_all();
+    }
+
+    void work() {
+        unique_lock<mutex> held(lock);
+        while (true) {
+            ready.wait(held, [this]() { return stopping || !jobs.empty(); });
+            if (stopping) return;
+
+            Job* job = jobs.front();
+            size_t item;
+            if (claim(job, item))
+                run(job, item, held);
+        }
+    }
+
+    public:
+    ThreadPool(size_t threads) {
+        stopping = false;
+        for (size_t i = 0; i < threads; i++)
+            workers.push_back(thread(&ThreadPool::work, this));
+    }
+
+    ~ThreadPool() {
+        {
+            lock_guard<mutex> held(lock);
+            stopping = true;
+        }
+        ready.notify_all();
+        for (size_t i = 0; i < workers.size(); i++)
+            workers[i].join();
+    }
+
+    size_t size() {
+        return workers.size() + 1;
+    }
+
+    // Calls task(i) for every i in [0, count) and returns once all are done.
+    void parallelFor(size_t count, const function<void(size_t)>& task) {
+        if (count == 0) return;
+
+        Job job = {&task, count, 0, count};
+        unique_lock<mutex> held(lock);
+        if (count > 1 && !workers.empty()) {
+            jobs.push_back(&job);
+            ready.notify_all();
+        }
+
+        size_t item;
+        while (claim(&job, item))
+            run(&job, item, held);
+        done.wait(held, [&job]() { return job.remaining == 0; });
+    }
+};
+
+// The process-wide pool: one worker per extra hardware thread. Never
+// destroyed, like Names().
+inline ThreadPool& Workers() {
+    static ThreadPool* pool = new ThreadPool(thread::hardware_concurrency() > 1
+                                             ? thread::hardware_concurrency() - 1 : 0);
+    return *pool;
+}
+
+#endif
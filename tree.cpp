@@ -2,239 +2,263 @@
 #include <iomanip>
 #include <string>
 #include <fstream>
+#include <sstream>
+#include <vector>
+#include <limits>
+#ifdef _WIN32
+#include <io.h>
+#define isatty _isatty
+#else
+#include <unistd.h>
+#endif
 #include "queue.hpp"
 #include "stack.hpp"
+#include "slotkey.hpp"
+#include "tree.hpp"
+#include "booking.hpp"
+#include "commands.hpp"
+#include "server.hpp"
 using namespace std;
 
-struct TreeNode {
-    Booking info;
-    TreeNode* left;
-    TreeNode* right;
-};
-
-struct WaitlistEntry {
-    string slotKey;
-    WaitlistQueue* queue;
-    WaitlistEntry* next;
-};
-
-WaitlistEntry* waitlistHead = NULL;
-
-WaitlistQueue* getWaitlist(string key) {
-    WaitlistEntry* current = waitlistHead;
-    
-    while (current != NULL) {
-        if (current->slotKey == key) {
-            return current->queue;
-        }
-        current = current->next;
-    }
-    
-    WaitlistEntry* newEntry = new WaitlistEntry;
-    newEntry->slotKey = key;
-    newEntry->queue = new WaitlistQueue();
-    newEntry->queue->createQueue();
-    newEntry->next = waitlistHead;
-    waitlistHead = newEntry;
-    
-    return newEntry->queue;
+template <class T>
+void PrintPoolStats(const char* name) {
+    typename NodePool<T>::Stats s = NodePool<T>::instance().stats();
+    cout << "| " << left << setw(17) << name << right
+         << " | " << setw(4) << s.nodeSize
+         << " | " << setw(8) << s.live
+         << " | " << setw(8) << s.peak
+         << " | " << setw(9) << s.bytesReserved
+         << " | " << setw(9) << s.allocations
+         << " | " << setw(9) << s.reused
+         << " |\n";
 }
 
-bool hasWaitlist(string key) {
-    WaitlistEntry* current = waitlistHead;
-    while (current != NULL) {
-        if (current->slotKey == key) {
-            return !current->queue->isEmpty();
-        }
-        current = current->next;
-    }
-    return false;
+void DisplayAllocatorStats() {
+    cout << "\n====================================================================================\n";
+    cout << "| Pool              | Size | Live     | Peak     | Reserved  | Allocs    | Reused    |\n";
+    cout << "====================================================================================\n";
+    PrintPoolStats<TreeNode>("TreeNode");
+    PrintPoolStats<RoomNode>("RoomNode");
+    cout << "====================================================================================\n";
+    cout << "Interned names: " << Names().size()
+         << " (" << Names().memoryUsage() << " bytes)\n";
 }
 
-string makeKey(const Booking& b) {
-    return b.date + (b.hour < 10 ? "0" : "") + to_string(b.hour) + b.room;
+void DisplayRuntimeStats(BookingStore& store) {
+    vector<StatValue> values;
+    Materialize(store);
+    CollectStats(store, values);
+
+    cout << "\n==========================================\n";
+    cout << "| Statistic               | Value        |\n";
+    cout << "==========================================\n";
+    for (size_t i = 0; i < values.size(); i++)
+        cout << "| " << left << setw(23) << values[i].name << right
+             << " | " << setw(12) << values[i].value << " |\n";
+    cout << "==========================================\n";
+
+    EngineStats& stats = Stats();
+    if (!STATS_ENABLED)
+        cout << "Counters are compiled out (built with BOOKING_NO_STATS).\n";
+    else if (stats.treeLookups > 0)
+        cout << "Nodes visited per tree descent: " << fixed << setprecision(2)
+             << (double)stats.treeSteps / stats.treeLookups << "\n";
 }
 
-string makeKey(string date, int hour, string room) {
-    return date + (hour < 10 ? "0" : "") + to_string(hour) + room;
+void menu() {
+    cout << "\n=== ROOM BOOKING SYSTEM ===\n";
+    cout << "1. Book Room\n";
+    cout << "2. Cancel Booking\n";
+    cout << "3. Search Booking\n";
+    cout << "4. Display All Bookings\n";
+    cout << "5. Display Schedule by Date\n";
+    cout << "6. Display Schedule by Room\n";
+    cout << "7. View Waitlist for a Slot\n";
+    cout << "8. Exit\n";
+    cout << "9. Display Room Schedule for a Date Range\n";
+    cout << "10. Allocator Statistics\n";
+    cout << "11. Find Free Slots\n";
+    cout << "12. Book Weekly Series\n";
+    cout << "13. Runtime Statistics\n";
+    cout << "Choose: ";
 }
 
-bool Insert(TreeNode*& tree, Booking b) {
-    if (tree == NULL) {
-        tree = new TreeNode{b, NULL, NULL};
-        return true;
-    }
-
-    string newKey = makeKey(b);
-    string curKey = makeKey(tree->info);
+// Rows per screen when a schedule is shown to someone at a terminal.
+const size_t REPORT_PAGE_ROWS = 40;
 
-    if (newKey == curKey)
-        return false;
-    else if (newKey < curKey)
-        return Insert(tree->left, b);
-    else
-        return Insert(tree->right, b);
+bool Interactive() {
+    return isatty(0) && isatty(1);
 }
 
-bool Search(TreeNode* tree, string key, Booking& result) {
-    if (tree == NULL) return false;
-
-    string curKey = makeKey(tree->info);
-
-    if (key == curKey) {
-        result = tree->info;
-        return true;
+// A schedule table streamed row by row as a query visits its bookings. The
+// header is printed with the first row, so an empty result prints nothing.
+class ScheduleTable {
+    private:
+    ReportWriter report;
+    bool started;
+
+    public:
+    ScheduleTable()
+        : report(cout, REPORT_TABLE, REPORT_PAGE_ROWS, Interactive() ? &cin : NULL) {
+        started = false;
+        if (Interactive()) cin.ignore(numeric_limits<streamsize>::max(), '\n');
     }
-    else if (key < curKey)
-        return Search(tree->left, key, result);
-    else
-        return Search(tree->right, key, result);
-}
-
-TreeNode* FindMin(TreeNode* tree) {
-    while (tree->left != NULL)
-        tree = tree->left;
-    return tree;
-}
 
-bool Delete(TreeNode*& tree, string key) {
-    if (tree == NULL) return false;
-
-    string curKey = makeKey(tree->info);
-
-    if (key < curKey)
-        return Delete(tree->left, key);
-    else if (key > curKey)
-        return Delete(tree->right, key);
-    else {
-        if (tree->left == NULL && tree->right == NULL) {
-            delete tree;
-            tree = NULL;
-        }
-        else if (tree->left == NULL) {
-            TreeNode* temp = tree;
-            tree = tree->right;
-            delete temp;
-        }
-        else if (tree->right == NULL) {
-            TreeNode* temp = tree;
-            tree = tree->left;
-            delete temp;
-        }
-        else {
-            TreeNode* temp = FindMin(tree->right);
-            tree->info = temp->info;
-            Delete(tree->right, makeKey(temp->info));
+    bool add(const Booking& b) {
+        if (!started) {
+            cout << "\n===========================================================\n";
+            cout << "|  Date  | Time | Room   | Lecturer     | Course     |\n";
+            cout << "===========================================================\n";
+            started = true;
         }
-        return true;
+        return report.add(b);
     }
-}
 
-void Display(TreeNode* tree) {
-    if (tree != NULL) {
-        Display(tree->left);
-
-        cout << "| " << setw(6) << tree->info.date
-             << " | " << setw(2) << tree->info.hour << ":00"
-             << " | " << setw(6) << tree->info.room
-             << " | " << setw(12) << tree->info.lecturer
-             << " | " << setw(10) << tree->info.course
-             << " |\n";
-
-        Display(tree->right);
+    // Closes the table; false if it had no rows.
+    bool finish() {
+        report.finish();
+        if (started) cout << "===========================================================\n";
+        return started;
     }
-}
-
+};
 
-void CollectDateHistory(TreeNode* tree, string date, BookingStack& history) {
-    if (tree != NULL) {
-        CollectDateHistory(tree->left, date, history);
-        
-        if (tree->info.date == date) {
-            history.push(tree->info);
-        }
-        
-        CollectDateHistory(tree->right, date, history);
+// Streams every booking to stdout as a table, CSV or JSON.
+int RunReport(BookingStore& store, const string& format) {
+    ReportFormat f;
+    if (format == "table") f = REPORT_TABLE;
+    else if (format == "csv") f = REPORT_CSV;
+    else if (format == "json") f = REPORT_JSON;
+    else {
+        cerr << "Unknown report format " << format << " (table, csv or json)\n";
+        return 1;
     }
+
+    vector<Booking> rows;
+    Materialize(store);
+    CollectAll(store, rows);
+    ReportWriter report(cout, f);
+    for (size_t i = 0; i < rows.size(); i++)
+        report.add(rows[i]);
+    report.finish();
+    cout.flush();
+    return 0;
 }
 
-void CollectRoomHistory(TreeNode* tree, string room, BookingStack& history) {
-    if (tree != NULL) {
-        CollectRoomHistory(tree->left, room, history);
-        
-        if (tree->info.room == room) {
-            history.push(tree->info);
+// Applies a command stream (see commands.hpp) and makes all of its changes
+// durable with one commit at the end. Results go to stdout as JSON lines.
+int RunBatch(BookingStore& store, istream& in) {
+    string line, out;
+    int lineNo = 0, errors = 0;
+    while (getline(in, line)) {
+        lineNo++;
+        if (ExecuteCommand(store, line, lineNo, out) == COMMAND_FAILED)
+            errors++;
+
+        if (out.size() >= 64 * 1024) {
+            cout.write(out.data(), out.size());
+            out.clear();
         }
-
-        CollectRoomHistory(tree->right, room, history);
     }
-}
-
-bool validDate(string d) {
-    if (d.length() != 6) return false;
-
-    int month = stoi(d.substr(2,2));
-    int day = stoi(d.substr(4,2));
+    cout.write(out.data(), out.size());
+    cout.flush();
 
-    return (month >= 1 && month <= 12 && day >= 1 && day <= 31);
+    CommitChanges(store);
+    return errors == 0 ? 0 : 2;
 }
 
-bool validHour(int h) {
-    return (h >= 8 && h <= 16);
-}
+int main(int argc, char* argv[]) {
+    // --durability MODE may come before any other option.
+    if (argc > 1 && string(argv[1]) == "--durability") {
+        Durability durability;
+        if (argc < 3 || !parseDurability(argv[2], durability)) {
+            cerr << "Unknown durability mode (sync, group or async)\n";
+            return 1;
+        }
+        journal.setDurability(durability);
+        argv[2] = argv[0];
+        argv += 2;
+        argc -= 2;
+    }
 
-bool validDuration(int startHour, int duration) {
-    return duration >= 1 && startHour + duration - 1 <= 16;
-}
+    if (argc > 1) {
+        string mode = argv[1];
+        if (mode == "--to-binary")
+            return ConvertToBinary(argc > 2 ? argv[2] : BOOKINGS_FILE,
+                                   argc > 3 ? argv[3] : SNAPSHOT_BIN_FILE) ? 0 : 1;
+        if (mode == "--to-csv")
+            return ConvertToCsv(argc > 2 ? argv[2] : SNAPSHOT_BIN_FILE,
+                                argc > 3 ? argv[3] : BOOKINGS_FILE) ? 0 : 1;
+#ifndef _WIN32
+        if (mode == "--serve") {
+            BookingStore store;
+            if (!LoadFromFile(store))
+                return 1;
+
+            const char* path = argc > 2 ? argv[2] : SERVER_SOCKET;
+            int status = 0;
+            {
+                BookingServer server(store);
+                string error;
+                if (server.listen(path, error)) {
+                    cerr << "Listening on " << path << "\n";
+                    server.run();
+                } else {
+                    cerr << path << ": " << error << "\n";
+                    status = 1;
+                }
+            }
+            journal.close();
+            store.clear();
+            return status;
+        }
+#endif
+        if (mode == "--batch") {
+            BookingStore store;
+            if (!LoadFromFile(store))
+                return 1;
+
+            int status;
+            if (argc < 3 || string(argv[2]) == "-") {
+                status = RunBatch(store, cin);
+            } else {
+                ifstream in(argv[2]);
+                if (!in) {
+                    cerr << argv[2] << ": cannot open file\n";
+                    status = 1;
+                } else {
+                    status = RunBatch(store, in);
+                }
+            }
+            journal.close();
+            store.clear();
+            return status;
+        }
 
-void SaveToFile(TreeNode* tree, ofstream& out) {
-    if (!tree) return;
-    SaveToFile(tree->left, out);
-    out << tree->info.date << "," << tree->info.hour << ","
-        << tree->info.room << "," << tree->info.lecturer << ","
-        << tree->info.course << endl;
-    SaveToFile(tree->right, out);
-}
+        if (mode == "--report") {
+            BookingStore store;
+            if (!LoadFromFile(store))
+                return 1;
 
-void RewriteFile(TreeNode* root) {
-    ofstream out("bookings.txt");
-    SaveToFile(root, out);
-    out.close();
-}
+            int status = RunReport(store, argc > 2 ? argv[2] : "table");
+            journal.close();
+            store.clear();
+            return status;
+        }
 
-void LoadFromFile(TreeNode*& root) {
-    ifstream in("bookings.txt");
-    if (!in) return;
-
-    Booking b;
-    while (getline(in, b.date, ',')) {
-        in >> b.hour; in.ignore();
-        getline(in, b.room, ',');
-        getline(in, b.lecturer, ',');
-        getline(in, b.course);
-        Insert(root, b);
+        cerr << "Usage: " << argv[0] << " [--durability sync|group|async]\n"
+             << "       [--batch [commands.txt|-] | --serve [socket] |\n"
+             << "       --report [table|csv|json] |\n"
+             << "       --to-binary [in.txt] [out.bin] | --to-csv [in.bin] [out.txt]]\n"
+             << "While " << SNAPSHOT_BIN_FILE << " exists it is used instead of " << BOOKINGS_FILE << ".\n";
+        return 1;
     }
-    in.close();
-}
-
-void menu() {
-    cout << "\n=== ROOM BOOKING SYSTEM ===\n";
-    cout << "1. Book Room\n";
-    cout << "2. Cancel Booking\n";
-    cout << "3. Search Booking\n";
-    cout << "4. Display All Bookings\n";
-    cout << "5. Display Schedule by Date\n";
-    cout << "6. Display Schedule by Room\n";
-    cout << "7. View Waitlist for a Slot\n";
-    cout << "8. Exit\n";
-    cout << "Choose: ";
-}
 
-int main() {
-    TreeNode* root = NULL;
-    LoadFromFile(root);
+    BookingStore store;
+    if (!LoadFromFile(store))
+        return 1;
 
     int choice;
+    ResultBuffer results;
 
     do {
         menu();
@@ -242,16 +266,17 @@ int main() {
 
         if (choice == 1) {
             Booking b;
+            string date, room, lecturer, course;
             int duration;
 
             do {
                 cout << "Enter Date (YYMMDD): ";
-                cin >> b.date;
+                cin >> date;
 
-                if (!validDate(b.date))
+                if (!validDate(date))
                     cout << "Invalid date. Please enter again.\n";
 
-            } while (!validDate(b.date));
+            } while (!validDate(date));
 
             do {
                 cout << "Enter Start Hour (8-16): ";
@@ -273,67 +298,52 @@ int main() {
 
             do {
                 cout << "Enter Room (1-20): ";
-                cin >> b.room;
-
-                try {
-                    int roomNum = stoi(b.room); 
-                    
-                    if (roomNum >= 1 && roomNum <= 20) {
-                        break; 
-                    } else {
-                        cout << "Choose an existing room (1-20) to book\n";
-                    }
-                } catch (...) {
-               
+                cin >> room;
+
+                int roomNum;
+                if (!parseRoom(room, roomNum)) {
                     cout << "Invalid input. Please enter a number between 1 and 20.\n";
+                } else if (roomNum >= 1 && roomNum <= ROOM_COUNT) {
+                    break;
+                } else {
+                    cout << "Choose an existing room (1-20) to book\n";
                 }
 
             } while (true);
             
             cin.ignore(); 
             cout << "Enter Lecturer: ";
-            getline(cin, b.lecturer);
+            getline(cin, lecturer);
 
             cout << "Enter Course: ";
-            getline(cin, b.course);
-
-            bool conflict = false;
-            for (int i = 0; i < duration; i++) {
-                Booking temp = b;
-                temp.hour = b.hour + i;
-                Booking dummy;
-                if (Search(root, makeKey(temp), dummy)) {
-                    conflict = true;
-                    break;
-                }
-            }
+            getline(cin, course);
 
-            if (conflict) {
+            makeBooking(date, b.hour, room, lecturer, course, b);
+
+            if (IsArchived(store, b.date)) {
+                cout << "\nError: Bookings for that week are archived.\n";
+            } else if (BookSlots(store, b, duration)) {
+                CommitChanges(store);
+                cout << "Booking successful.\n";
+            } else {
                 cout << "\nError: One or more time slots already booked.\n";
+
+                Booking alternative;
+                if (NearestFreeSlot(store, b.date, b.room, b.hour, duration, alternative))
+                    cout << "Nearest free slot: " << formatDate(alternative.date) << " "
+                         << alternative.hour << ":00 Room " << alternative.room << "\n";
+
                 cout << "Would you like to join the waitlist? (y/n): ";
                 char response;
                 cin >> response;
 
                 if (response == 'y' || response == 'Y') {
-                    for (int i = 0; i < duration; i++) {
-                        Booking temp = b;
-                        temp.hour = b.hour + i;
-                        string key = makeKey(temp);
-                        WaitlistQueue* wq = getWaitlist(key);
-                        wq->enQueue(temp);
-                    }
+                    JoinWaitlist(store, b, duration);
+                    CommitChanges(store);
                     cout << "Added to waitlist successfully!\n";
                 } else {
                     cout << "Booking not added to waitlist.\n";
                 }
-            } else {
-                for (int i = 0; i < duration; i++) {
-                    Booking temp = b;
-                    temp.hour = b.hour + i;
-                    Insert(root, temp);
-                }
-                RewriteFile(root);
-                cout << "Booking successful.\n";
             }
         }
 
@@ -344,47 +354,45 @@ int main() {
             cout << "Enter Date (YYMMDD): ";
             cin >> date;
 
-            cout << "Enter Start Hour (8-16): ";
-            cin >> startHour;
-
-            cout << "Enter Duration (hours): ";
-            cin >> duration;
-
-            cout << "Enter Room: ";
-            cin >> room;
+            do {
+                cout << "Enter Start Hour (8-16): ";
+                cin >> startHour;
 
-            bool found = false;
+                if (!validHour(startHour))
+                    cout << "Invalid hour. Must be between 8 and 16.\n";
 
-            for (int i = 0; i < duration; i++) {
-                int hour = startHour + i;
-                string key = makeKey(date, hour, room);
+            } while (!validHour(startHour));
 
-                if (Delete(root, key)) {
-                    found = true;
+            do {
+                cout << "Enter Duration (hours): ";
+                cin >> duration;
 
-                   
-                    if (hasWaitlist(key)) {
-                        WaitlistQueue* wq = getWaitlist(key);
-                        Booking* nextBooking = wq->deQueue();
+                if (!validDuration(startHour, duration))
+                    cout << "Error: Class exceeds 5pm.\n";
 
-                        if (nextBooking) {
-                            Insert(root, *nextBooking);
+            } while (!validDuration(startHour, duration));
 
-                            cout << "\n[System] Waitlist found for slot " 
-                                << date << " " << hour << ":00 Room " << room << endl;
-                            cout << "[System] Automatically promoted: " 
-                                << nextBooking->lecturer 
-                                << " (" << nextBooking->course << ")" << endl;
+            cout << "Enter Room: ";
+            cin >> room;
 
-                            delete nextBooking;
-                        }
-                    }
-                }
+            vector<Booking> removed, promoted;
+            int day = 0, roomId = 0;
+            if (parseDate(date, day) && parseRoom(room, roomId))
+                CancelSlots(store, day, roomId, startHour, duration, removed, promoted);
+
+            for (size_t i = 0; i < promoted.size(); i++) {
+                cout << "\n[System] Waitlist found for slot " 
+                    << date << " " << promoted[i].hour << ":00 Room " << room << endl;
+                cout << "[System] Automatically promoted: " 
+                    << Names().name(promoted[i].lecturer) 
+                    << " (" << Names().name(promoted[i].course) << ")" << endl;
             }
 
-            if (found) {
-                RewriteFile(root);  
+            if (!removed.empty()) {
+                CommitChanges(store);
                 cout << "\nBooking cancelled successfully.\n";
+            } else if (IsArchived(store, day)) {
+                cout << "Bookings for that week are archived.\n";
             } else {
                 cout << "No matching booking found.\n";
             }
@@ -402,10 +410,11 @@ int main() {
             cout << "Enter Room: ";
             cin >> room;
 
-            if (Search(root, makeKey(date, hour, room), b)) {
+            SlotKey key = 0;
+            if (makeKey(date, hour, room, key) && FindBooking(store, key, b)) {
                 cout << "\n--- Booking Found ---\n";
-                cout << "Lecturer: " << b.lecturer << endl;
-                cout << "Course: " << b.course << endl;
+                cout << "Lecturer: " << Names().name(b.lecturer) << endl;
+                cout << "Course: " << Names().name(b.course) << endl;
             } else {
                 cout << "Booking not found.\n";
             }
@@ -415,7 +424,15 @@ int main() {
             cout << "\n===========================================================\n";
             cout << "|  Date  | Time | Room   | Lecturer     | Course     |\n";
             cout << "===========================================================\n";
-            Display(root);
+            results.clear();
+            Materialize(store);
+            CollectAll(store, results.items());
+            if (Interactive()) {
+                cin.ignore(numeric_limits<streamsize>::max(), '\n');
+                Display(results.items(), REPORT_PAGE_ROWS, &cin);
+            } else {
+                Display(results.items());
+            }
             cout << "===========================================================\n";
         }
         
@@ -424,20 +441,17 @@ int main() {
             cout << "Enter Date (YYMMDD): ";
             cin >> date;
 
-            BookingStack history;
-            CollectDateHistory(root, date, history);
+            ScheduleTable table;
+            int day;
+            results.clear();
+            if (parseDate(date, day))
+                DateSchedule(store, day, results.items());
+            for (size_t i = 0; i < results.size(); i++) {
+                if (!table.add(results[i])) break;
+            }
 
-            if (history.isEmpty()) {
+            if (!table.finish())
                 cout << "\nNo booking history for Room " << date << ".\n";
-            } else {
-                cout << "\n===========================================================\n";
-                cout << "|  Date  | Time | Room   | Lecturer     | Course     |\n";
-                cout << "===========================================================\n";
-                
-                history.display();
-                
-                cout << "===========================================================\n";
-            }
         }
 
         else if (choice == 6) {
@@ -445,20 +459,17 @@ int main() {
             cout << "Enter Room: ";
             cin >> room;
 
-            BookingStack history;
-            CollectRoomHistory(root, room, history);
+            ScheduleTable table;
+            int roomId;
+            results.clear();
+            if (parseRoom(room, roomId))
+                RoomSchedule(store, roomId, 0, LAST_DAY, results.items());
+            for (size_t i = 0; i < results.size(); i++) {
+                if (!table.add(results[i])) break;
+            }
 
-            if (history.isEmpty()) {
+            if (!table.finish())
                 cout << "\nNo booking history for Room " << room << ".\n";
-            } else {
-                cout << "\n===========================================================\n";
-                cout << "|  Date  | Time | Room   | Lecturer     | Course     |\n";
-                cout << "===========================================================\n";
-                
-                history.display();
-                
-                cout << "===========================================================\n";
-            }
         }
 
         else if (choice == 7) {
@@ -472,31 +483,148 @@ int main() {
             cout << "Enter Room: ";
             cin >> room;
 
-            string key = makeKey(date, hour, room);
+            SlotKey key = 0;
+            bool validSlot = makeKey(date, hour, room, key);
+            WaitlistRegistry* waitlists = validSlot ? WaitlistsFor(store, slotDay(key)) : NULL;
 
             cout << "\n--- Waitlist for " << date << " at " << hour << ":00 in Room " << room << " ---\n";
             
-            if (hasWaitlist(key)) {
-                WaitlistQueue* wq = getWaitlist(key);
+            if (waitlists != NULL && waitlists->has(key)) {
+                WaitlistQueue* wq = waitlists->find(key);
                 wq->display();
                 cout << "Total waiting: " << wq->getSize() << "\n";
             } else {
                 cout << "No waitlist exists for this slot.\n";
             }
+            cout << "Active waitlists: " << store.waitlistCount()
+                 << " (" << store.waitlistMemory() << " bytes)\n";
         }
 
-    } while (choice != 8);
+        else if (choice == 9) {
+            string room, fromDate, toDate;
+            cout << "Enter Room: ";
+            cin >> room;
+            cout << "Enter From Date (YYMMDD): ";
+            cin >> fromDate;
+            cout << "Enter To Date (YYMMDD): ";
+            cin >> toDate;
+
+            ScheduleTable table;
+            int roomId, fromDay, toDay;
+            results.clear();
+            if (parseRoom(room, roomId) && parseDate(fromDate, fromDay) && parseDate(toDate, toDay))
+                RoomSchedule(store, roomId, fromDay, toDay, results.items());
+            for (size_t i = 0; i < results.size(); i++) {
+                if (!table.add(results[i])) break;
+            }
 
-    WaitlistEntry* current = waitlistHead;
-    while (current != NULL) {
-        WaitlistEntry* temp = current;
-        current = current->next;
-        if (temp->queue) {
-            temp->queue->destroyQueue();
-            delete temp->queue;
+            if (!table.finish())
+                cout << "\nNo bookings for Room " << room << " from "
+                     << fromDate << " to " << toDate << ".\n";
         }
-        delete temp;
-    }
 
+        else if (choice == 10) {
+            DisplayAllocatorStats();
+        }
+
+        else if (choice == 11) {
+            string date;
+            int hour, duration, day;
+
+            cout << "Enter Date (YYMMDD): ";
+            cin >> date;
+            cout << "Enter Start Hour (8-16): ";
+            cin >> hour;
+            cout << "Enter Duration (hours): ";
+            cin >> duration;
+
+            if (!parseDate(date, day) || !validHour(hour) || !validDuration(hour, duration)) {
+                cout << "Invalid date, hour or duration.\n";
+            } else if (IsArchived(store, day)) {
+                cout << "Bookings for that week are archived.\n";
+            } else {
+                vector<int> rooms;
+                Materialize(store);
+                FreeRooms(store, day, hour, duration, rooms);
+
+                cout << "\nFree rooms at " << hour << ":00 for " << duration << " hour(s):";
+                for (size_t i = 0; i < rooms.size(); i++)
+                    cout << " " << rooms[i];
+                cout << (rooms.empty() ? " none\n" : "\n");
+
+                int room, startHour;
+                if (FirstFreeBlock(store, day, duration, room, startHour))
+                    cout << "Earliest free block on " << date << ": " << startHour
+                         << ":00 Room " << room << "\n";
+                else
+                    cout << "No free block of " << duration << " hour(s) on " << date << ".\n";
+            }
+        }
+
+        else if (choice == 12) {
+            Booking b;
+            string date, untilDate, room, lecturer, course;
+            int duration, lastDay;
+
+            cout << "Enter First Date (YYMMDD): ";
+            cin >> date;
+            cout << "Enter Last Date (YYMMDD): ";
+            cin >> untilDate;
+            cout << "Enter Start Hour (8-16): ";
+            cin >> b.hour;
+            cout << "Enter Duration (hours): ";
+            cin >> duration;
+            cout << "Enter Room (1-20): ";
+            cin >> room;
+            cin.ignore();
+            cout << "Enter Lecturer: ";
+            getline(cin, lecturer);
+            cout << "Enter Course: ";
+            getline(cin, course);
+
+            int roomNum;
+            if (!validDate(date) || !parseDate(untilDate, lastDay) || !validHour(b.hour) ||
+                !validDuration(b.hour, duration) || !parseRoom(room, roomNum) ||
+                roomNum < 1 || roomNum > ROOM_COUNT) {
+                cout << "Invalid date, hour, duration or room.\n";
+                continue;
+            }
+            makeBooking(date, b.hour, room, lecturer, course, b);
+
+            vector<int> booked, conflicts;
+            if (!BookSeries(store, b, duration, lastDay, false, booked, conflicts)) {
+                cout << "\nError: Part of the series falls in archived weeks.\n";
+            } else if (conflicts.empty()) {
+                CommitChanges(store);
+                cout << "Booked " << booked.size() << " weekly occurrence(s).\n";
+            } else {
+                cout << "\nError: The slot is already booked on:";
+                for (size_t i = 0; i < conflicts.size(); i++)
+                    cout << " " << formatDate(conflicts[i]);
+                cout << "\nBook the other dates and join the waitlist for these? (y/n): ";
+                char response;
+                cin >> response;
+
+                if (response == 'y' || response == 'Y') {
+                    booked.clear();
+                    conflicts.clear();
+                    BookSeries(store, b, duration, lastDay, true, booked, conflicts);
+                    CommitChanges(store);
+                    cout << "Booked " << booked.size() << " occurrence(s), waitlisted "
+                         << conflicts.size() << ".\n";
+                } else {
+                    cout << "Nothing was booked.\n";
+                }
+            }
+        }
+
+        else if (choice == 13) {
+            DisplayRuntimeStats(store);
+        }
+
+    } while (choice != 8);
+
+    journal.close();
+    store.clear();
     return 0;
 }
\ No newline at end of file
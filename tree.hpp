@@ -0,0 +1,681 @@
+#ifndef TREE_HPP
+#define TREE_HPP
+
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <iterator>
+#include "queue.hpp"
+#include "slotkey.hpp"
+#include "pool.hpp"
+#include "report.hpp"
+#include "stats.hpp"
+using namespace std;
+
+// Booking index: AVL trees with parent links. Every operation walks the
+// tree with loops instead of recursion, so stack usage does not grow with
+// the number of bookings, and the height stays within 1.44 log2(n).
+//
+// The primary tree is keyed by slot key (date, room, hour), so a date's
+// bookings are one contiguous range of it. A second tree keyed by
+// (room, date, hour) points back at the primary nodes and serves room
+// schedules the same way.
+struct TreeNode {
+    SlotKey key;
+    Booking info;
+    TreeNode* left;
+    TreeNode* right;
+    TreeNode* parent;
+    int height;
+
+    USE_NODE_POOL(TreeNode)
+};
+
+struct RoomNode {
+    SlotKey key;
+    TreeNode* booking;
+    RoomNode* left;
+    RoomNode* right;
+    RoomNode* parent;
+    int height;
+
+    USE_NODE_POOL(RoomNode)
+};
+
+struct BookingIndex {
+    TreeNode* root;
+    RoomNode* byRoom;
+    int count;
+
+    BookingIndex() {
+        root = NULL;
+        byRoom = NULL;
+        count = 0;
+    }
+};
+
+inline SlotKey makeRoomKey(int room, int day, int hour) {
+    return ((SlotKey)room << 40) | ((SlotKey)day << SLOT_HOUR_BITS) | (SlotKey)hour;
+}
+
+inline SlotKey roomKeyOf(SlotKey key) {
+    return makeRoomKey(slotRoom(key), slotDay(key), slotHour(key));
+}
+
+template <class Node>
+int Height(Node* tree) {
+    return tree ? tree->height : 0;
+}
+
+template <class Node>
+void UpdateHeight(Node* tree) {
+    tree->height = 1 + max(Height(tree->left), Height(tree->right));
+}
+
+template <class Node>
+void ReplaceChild(Node*& root, Node* parent, Node* oldChild, Node* newChild) {
+    if (parent == NULL)
+        root = newChild;
+    else if (parent->left == oldChild)
+        parent->left = newChild;
+    else
+        parent->right = newChild;
+
+    if (newChild != NULL)
+        newChild->parent = parent;
+}
+
+template <class Node>
+Node* RotateLeft(Node*& root, Node* tree) {
+    Node* pivot = tree->right;
+    tree->right = pivot->left;
+    if (pivot->left != NULL)
+        pivot->left->parent = tree;
+
+    ReplaceChild(root, tree->parent, tree, pivot);
+    pivot->left = tree;
+    tree->parent = pivot;
+
+    UpdateHeight(tree);
+    UpdateHeight(pivot);
+    return pivot;
+}
+
+template <class Node>
+Node* RotateRight(Node*& root, Node* tree) {
+    Node* pivot = tree->left;
+    tree->left = pivot->right;
+    if (pivot->right != NULL)
+        pivot->right->parent = tree;
+
+    ReplaceChild(root, tree->parent, tree, pivot);
+    pivot->right = tree;
+    tree->parent = pivot;
+
+    UpdateHeight(tree);
+    UpdateHeight(pivot);
+    return pivot;
+}
+
+// Walks from tree towards the root, restoring the AVL balance on the way.
+// Stops as soon as a subtree ends up with its old height, since nothing
+// above it can have changed; this keeps rebalancing amortised O(1).
+template <class Node>
+void Rebalance(Node*& root, Node* tree) {
+    while (tree != NULL) {
+        int oldHeight = tree->height;
+        UpdateHeight(tree);
+        int balance = Height(tree->left) - Height(tree->right);
+
+        if (balance > 1) {
+            if (Height(tree->left->left) < Height(tree->left->right))
+                RotateLeft(root, tree->left);
+            tree = RotateRight(root, tree);
+        }
+        else if (balance < -1) {
+            if (Height(tree->right->right) < Height(tree->right->left))
+                RotateRight(root, tree->right);
+            tree = RotateLeft(root, tree);
+        }
+
+        if (tree->height == oldHeight)
+            break;
+        tree = tree->parent;
+    }
+}
+
+template <class Node>
+Node* FindMin(Node* tree) {
+    while (tree->left != NULL)
+        tree = tree->left;
+    return tree;
+}
+
+template <class Node>
+Node* Successor(Node* tree) {
+    if (tree->right != NULL)
+        return FindMin(tree->right);
+
+    while (tree->parent != NULL && tree == tree->parent->right)
+        tree = tree->parent;
+    return tree->parent;
+}
+
+template <class Node>
+Node* First(Node* tree) {
+    return tree ? FindMin(tree) : NULL;
+}
+
+// Descents count the nodes they visit in Stats() (see stats.hpp).
+template <class Node>
+Node* Find(Node* tree, SlotKey key) {
+    uint64_t steps = 0;
+    while (tree != NULL && key != tree->key) {
+        steps++;
+        tree = key < tree->key ? tree->left : tree->right;
+    }
+    STAT_ADD(treeLookups, 1);
+    STAT_ADD(treeSteps, steps + (tree != NULL));
+    return tree;
+}
+
+// First node whose key is >= key, or NULL.
+template <class Node>
+Node* LowerBound(Node* tree, SlotKey key) {
+    Node* result = NULL;
+    uint64_t steps = 0;
+    while (tree != NULL) {
+        steps++;
+        if (tree->key >= key) {
+            result = tree;
+            tree = tree->left;
+        } else {
+            tree = tree->right;
+        }
+    }
+    STAT_ADD(treeLookups, 1);
+    STAT_ADD(treeSteps, steps);
+    return result;
+}
+
+// Links node (key already set) into the tree. Fails on a duplicate key.
+template <class Node>
+bool LinkNode(Node*& root, Node* node) {
+    Node* parent = NULL;
+    Node* cur = root;
+    bool goLeft = false;
+    uint64_t steps = 0;
+
+    while (cur != NULL) {
+        steps++;
+        if (node->key == cur->key) {
+            STAT_ADD(treeLookups, 1);
+            STAT_ADD(treeSteps, steps);
+            return false;
+        }
+
+        parent = cur;
+        goLeft = node->key < cur->key;
+        cur = goLeft ? cur->left : cur->right;
+    }
+
+    STAT_ADD(treeLookups, 1);
+    STAT_ADD(treeSteps, steps);
+    node->left = node->right = NULL;
+    node->parent = parent;
+    node->height = 1;
+
+    if (parent == NULL)
+        root = node;
+    else if (goLeft)
+        parent->left = node;
+    else
+        parent->right = node;
+
+    Rebalance(root, parent);
+    return true;
+}
+
+// Links node directly after prev in key order. The caller guarantees that
+// no key lies between them, so no descent from the root is needed.
+template <class Node>
+void LinkAfter(Node*& root, Node* prev, Node* node) {
+    node->left = node->right = NULL;
+    node->height = 1;
+
+    Node* parent;
+    if (prev->right == NULL) {
+        parent = prev;
+        parent->right = node;
+    } else {
+        parent = FindMin(prev->right);
+        parent->left = node;
+    }
+    node->parent = parent;
+
+    Rebalance(root, parent);
+}
+
+// Unlinks node from the tree without freeing it. A node with two children
+// is replaced by its in-order successor node, so no other node moves.
+template <class Node>
+void UnlinkNode(Node*& root, Node* node) {
+    Node* rebalanceFrom;
+
+    if (node->left != NULL && node->right != NULL) {
+        Node* succ = FindMin(node->right);
+
+        if (succ->parent == node) {
+            rebalanceFrom = succ;
+        } else {
+            rebalanceFrom = succ->parent;
+            ReplaceChild(root, succ->parent, succ, succ->right);
+            succ->right = node->right;
+            node->right->parent = succ;
+        }
+
+        succ->left = node->left;
+        node->left->parent = succ;
+        ReplaceChild(root, node->parent, node, succ);
+        succ->height = node->height;
+    }
+    else {
+        Node* child = node->left ? node->left : node->right;
+        rebalanceFrom = node->parent;
+        ReplaceChild(root, node->parent, node, child);
+    }
+
+    Rebalance(root, rebalanceFrom);
+}
+
+template <class Node>
+void DestroyTree(Node*& tree) {
+    Node* cur = tree;
+    while (cur != NULL) {
+        if (cur->left != NULL) {
+            cur = cur->left;
+        }
+        else if (cur->right != NULL) {
+            cur = cur->right;
+        }
+        else {
+            Node* parent = cur->parent;
+            if (parent != NULL) {
+                if (parent->left == cur) parent->left = NULL;
+                else parent->right = NULL;
+            }
+            delete cur;
+            cur = parent;
+        }
+    }
+    tree = NULL;
+}
+
+inline bool Insert(BookingIndex& index, Booking b) {
+    SlotKey key;
+    if (!makeKey(b, key)) return false;
+
+    TreeNode* node = new TreeNode{key, b, NULL, NULL, NULL, 1};
+    if (!LinkNode(index.root, node)) {
+        delete node;
+        return false;
+    }
+
+    RoomNode* roomNode = new RoomNode{roomKeyOf(key), node, NULL, NULL, NULL, 1};
+    LinkNode(index.byRoom, roomNode);
+    index.count++;
+    return true;
+}
+
+inline bool Search(BookingIndex& index, SlotKey key, Booking& result) {
+    TreeNode* node = Find(index.root, key);
+    if (node == NULL) return false;
+
+    result = node->info;
+    return true;
+}
+
+inline void EraseNode(BookingIndex& index, TreeNode* node) {
+    RoomNode* roomNode = Find(index.byRoom, roomKeyOf(node->key));
+    UnlinkNode(index.byRoom, roomNode);
+    delete roomNode;
+
+    UnlinkNode(index.root, node);
+    delete node;
+    index.count--;
+}
+
+inline bool Delete(BookingIndex& index, SlotKey key) {
+    TreeNode* node = Find(index.root, key);
+    if (node == NULL) return false;
+
+    EraseNode(index, node);
+    return true;
+}
+
+// True if none of the duration hours from startHour in room on day is
+// booked. One descent: the block's keys are contiguous in the primary tree.
+inline bool BlockIsFree(BookingIndex& index, int day, int room, int startHour, int duration) {
+    TreeNode* node = LowerBound(index.root, makeSlotKey(day, room, startHour));
+    return node == NULL || node->key >= makeSlotKey(day, room, startHour + duration);
+}
+
+// Books duration consecutive hours starting at b.hour, or nothing at all if
+// any of them is taken. The first hour is placed with one descent per tree;
+// every later hour is linked straight after the previous one.
+inline bool InsertBlock(BookingIndex& index, Booking b, int duration) {
+    SlotKey first;
+    if (duration < 1 || !makeKey(b, first) || b.hour + duration > 24) return false;
+
+    int day = b.date, room = b.room;
+    if (!BlockIsFree(index, day, room, b.hour, duration)) return false;
+
+    TreeNode* prev = NULL;
+    RoomNode* prevRoom = NULL;
+    int startHour = b.hour;
+
+    for (int i = 0; i < duration; i++) {
+        b.hour = startHour + i;
+        SlotKey key = makeSlotKey(day, room, b.hour);
+
+        TreeNode* node = new TreeNode{key, b, NULL, NULL, NULL, 1};
+        RoomNode* roomNode = new RoomNode{roomKeyOf(key), node, NULL, NULL, NULL, 1};
+
+        if (prev == NULL) {
+            LinkNode(index.root, node);
+            LinkNode(index.byRoom, roomNode);
+        } else {
+            LinkAfter(index.root, prev, node);
+            LinkAfter(index.byRoom, prevRoom, roomNode);
+        }
+
+        prev = node;
+        prevRoom = roomNode;
+        index.count++;
+    }
+    return true;
+}
+
+// Removes every booked hour of room on day in [startHour, startHour +
+// duration) with one descent per tree, appending the removed bookings to
+// removed in hour order. Returns how many were removed; a block that does
+// not fit in the day's 24 hours removes nothing.
+inline int DeleteBlock(BookingIndex& index, int day, int room, int startHour, int duration,
+                       vector<Booking>& removed) {
+    if (duration < 1 || startHour < 0 || startHour + duration > 24) return 0;
+
+    SlotKey end = makeSlotKey(day, room, startHour + duration);
+    TreeNode* node = LowerBound(index.root, makeSlotKey(day, room, startHour));
+    RoomNode* roomNode = LowerBound(index.byRoom, makeRoomKey(room, day, startHour));
+    int count = 0;
+
+    while (node != NULL && node->key < end) {
+        TreeNode* next = Successor(node);
+        RoomNode* nextRoom = Successor(roomNode);
+
+        removed.push_back(node->info);
+        UnlinkNode(index.byRoom, roomNode);
+        delete roomNode;
+        UnlinkNode(index.root, node);
+        delete node;
+
+        index.count--;
+        count++;
+        node = next;
+        roomNode = nextRoom;
+    }
+    return count;
+}
+
+template <class Node>
+Node* BuildBalanced(Node** nodes, size_t count, Node* parent) {
+    if (count == 0) return NULL;
+
+    size_t mid = count / 2;
+    Node* node = nodes[mid];
+    node->parent = parent;
+    node->left = BuildBalanced(nodes, mid, node);
+    node->right = BuildBalanced(nodes + mid + 1, count - mid - 1, node);
+    UpdateHeight(node);
+    return node;
+}
+
+// Fills an empty index from bookings already in slot-key order with no
+// repeated slot, in O(n): both trees are built perfectly balanced from
+// sorted node arrays. The room order comes from a stable counting sort by
+// room, since within one room slot-key order is already (date, hour).
+inline void BuildIndex(BookingIndex& index, const vector<Booking>& sorted) {
+    size_t n = sorted.size();
+    vector<TreeNode*> nodes(n);
+    vector<RoomNode*> roomNodes(n);
+    int maxRoom = 0;
+
+    for (size_t i = 0; i < n; i++) {
+        const Booking& b = sorted[i];
+        nodes[i] = new TreeNode{makeSlotKey(b.date, b.room, b.hour), b, NULL, NULL, NULL, 1};
+        maxRoom = max(maxRoom, b.room);
+    }
+
+    vector<size_t> start(maxRoom + 2, 0);
+    for (size_t i = 0; i < n; i++)
+        start[sorted[i].room + 1]++;
+    for (int r = 1; r <= maxRoom + 1; r++)
+        start[r] += start[r - 1];
+    for (size_t i = 0; i < n; i++) {
+        RoomNode* roomNode = new RoomNode{roomKeyOf(nodes[i]->key), nodes[i], NULL, NULL, NULL, 1};
+        roomNodes[start[sorted[i].room]++] = roomNode;
+    }
+
+    index.root = BuildBalanced(nodes.data(), n, (TreeNode*)NULL);
+    index.byRoom = BuildBalanced(roomNodes.data(), n, (RoomNode*)NULL);
+    index.count = (int)n;
+}
+
+// Frees every node. Nodes hold no owned memory, so when this index owns
+// all live nodes the pools are simply dropped in bulk.
+inline void DestroyIndex(BookingIndex& index) {
+    if (NodePool<TreeNode>::instance().stats().live == (size_t)index.count &&
+        NodePool<RoomNode>::instance().stats().live == (size_t)index.count) {
+        NodePool<TreeNode>::instance().releaseAll();
+        NodePool<RoomNode>::instance().releaseAll();
+        index.root = NULL;
+        index.byRoom = NULL;
+    } else {
+        DestroyTree(index.byRoom);
+        DestroyTree(index.root);
+    }
+    index.count = 0;
+}
+
+inline const Booking& bookingOf(TreeNode* node) {
+    return node->info;
+}
+
+inline const Booking& bookingOf(RoomNode* node) {
+    return node->booking->info;
+}
+
+// The bookings of one tree with keys in [from, end), in key order. Iterating
+// follows parent links, so it neither recurses nor allocates:
+//   for (const Booking& b : DateRange(index, day, day)) ...
+template <class Node>
+class BookingRange {
+    private:
+    Node* first;
+    SlotKey last;
+
+    public:
+    class iterator {
+        private:
+        Node* node;
+        SlotKey end;
+
+        public:
+        typedef forward_iterator_tag iterator_category;
+        typedef Booking value_type;
+        typedef ptrdiff_t difference_type;
+        typedef const Booking* pointer;
+        typedef const Booking& reference;
+
+        iterator(Node* start, SlotKey endKey) {
+            node = (start != NULL && start->key < endKey) ? start : NULL;
+            end = endKey;
+        }
+
+        const Booking& operator*() const {
+            return bookingOf(node);
+        }
+
+        const Booking* operator->() const {
+            return &bookingOf(node);
+        }
+
+        iterator& operator++() {
+            node = Successor(node);
+            if (node != NULL && node->key >= end) node = NULL;
+            return *this;
+        }
+
+        bool operator!=(const iterator& other) const {
+            return node != other.node;
+        }
+
+        bool operator==(const iterator& other) const {
+            return node == other.node;
+        }
+    };
+
+    BookingRange(Node* root, SlotKey from, SlotKey end) {
+        first = LowerBound(root, from);
+        last = end;
+    }
+
+    iterator begin() const {
+        return iterator(first, last);
+    }
+
+    iterator end() const {
+        return iterator(NULL, last);
+    }
+};
+
+inline BookingRange<TreeNode> AllBookings(const BookingIndex& index) {
+    return BookingRange<TreeNode>(index.root, 0, ~0ULL);
+}
+
+// Bookings dated fromDay .. toDay, in slot order.
+inline BookingRange<TreeNode> DateRange(const BookingIndex& index, int fromDay, int toDay) {
+    return BookingRange<TreeNode>(index.root, makeSlotKey(fromDay, 0, 0), makeSlotKey(toDay + 1, 0, 0));
+}
+
+// One room's bookings dated fromDay .. toDay, in date and hour order.
+inline BookingRange<RoomNode> RoomRange(const BookingIndex& index, int room, int fromDay, int toDay) {
+    return BookingRange<RoomNode>(index.byRoom, makeRoomKey(room, fromDay, 0), makeRoomKey(room, toDay + 1, 0));
+}
+
+// Visitors take a booking and return false to stop the walk. Matching()
+// wraps one so it only sees the bookings a filter accepts.
+template <class Filter, class Visit>
+struct FilteredVisit {
+    Filter filter;
+    Visit visit;
+
+    bool operator()(const Booking& b) {
+        return !filter(b) || visit(b);
+    }
+};
+
+template <class Filter, class Visit>
+FilteredVisit<Filter, Visit> Matching(Filter filter, Visit visit) {
+    FilteredVisit<Filter, Visit> filtered = {filter, visit};
+    return filtered;
+}
+
+// Calls visit for each booking of range until it returns false. Returns
+// false if it stopped early.
+template <class Range, class Visit>
+bool VisitRange(const Range& range, Visit& visit) {
+    for (typename Range::iterator i = range.begin(); i != range.end(); ++i) {
+        if (!visit(*i)) return false;
+    }
+    return true;
+}
+
+// Filters. Names are compared by text, so a filter never interns.
+struct LecturerIs {
+    string name;
+
+    bool operator()(const Booking& b) const {
+        return Names().name(b.lecturer) == name;
+    }
+};
+
+struct CourseIs {
+    string name;
+
+    bool operator()(const Booking& b) const {
+        return Names().name(b.course) == name;
+    }
+};
+
+struct HoursBetween {
+    int fromHour;
+    int toHour;
+
+    bool operator()(const Booking& b) const {
+        return b.hour >= fromHour && b.hour < toHour;
+    }
+};
+
+// Query results in one contiguous array. clear() keeps the capacity, so a
+// buffer reused across queries stops allocating once it has held the
+// largest result.
+class ResultBuffer {
+    private:
+    vector<Booking> rows;
+
+    public:
+    bool add(const Booking& b) {
+        rows.push_back(b);
+        return true;
+    }
+
+    void clear() {
+        rows.clear();
+    }
+
+    size_t size() const {
+        return rows.size();
+    }
+
+    bool empty() const {
+        return rows.empty();
+    }
+
+    const Booking& operator[](size_t i) const {
+        return rows[i];
+    }
+
+    vector<Booking>::const_iterator begin() const {
+        return rows.begin();
+    }
+
+    vector<Booking>::const_iterator end() const {
+        return rows.end();
+    }
+
+    // The array itself, for the Collect* functions that append to a vector.
+    vector<Booking>& items() {
+        return rows;
+    }
+};
+
+// Prints rows as schedule table lines, pausing every pageRows rows for
+// Enter on pager when one is given.
+inline void Display(const vector<Booking>& rows, size_t pageRows = 0, istream* pager = NULL) {
+    ReportWriter report(cout, REPORT_TABLE, pageRows, pager);
+    for (size_t i = 0; i < rows.size() && report.add(rows[i]); i++) {}
+}
+
+#endif
@@ -0,0 +1,180 @@
+#ifndef WAITLIST_HPP
+#define WAITLIST_HPP
+
+#include <cstddef>
+#include <mutex>
+#include <shared_mutex>
+#include "queue.hpp"
+#include "slotkey.hpp"
+using namespace std;
+
+// Maps a slot key to its waitlist. Open addressing with linear probing and
+// backward-shift deletion, so there are no tombstones: a queue that empties
+// is freed and its bucket reused straight away.
+//
+// The server joins waitlists under the engine lock held shared, so get,
+// find and forEach may run from many threads at once: the table has its own
+// lock, taken exclusively only to add a queue, and queues accept concurrent
+// enQueue calls. dequeue and clear free queues, so they need the engine
+// lock held exclusively, which keeps every joining thread out; that lock
+// also makes the promoting thread the queues' single consumer.
+class WaitlistRegistry {
+    private:
+    struct Bucket {
+        SlotKey key;
+        WaitlistQueue* queue;
+    };
+
+    Bucket* table;
+    size_t capacity;
+    size_t count;
+    shared_mutex tableLock;
+
+    static size_t hash(SlotKey key) {
+        key ^= key >> 33;
+        key *= 0xff51afd7ed558ccdULL;
+        key ^= key >> 33;
+        return (size_t)key;
+    }
+
+    size_t findIndex(SlotKey key) {
+        size_t mask = capacity - 1;
+        size_t i = hash(key) & mask;
+        while (table[i].queue != NULL && table[i].key != key)
+            i = (i + 1) & mask;
+        return i;
+    }
+
+    void grow() {
+        Bucket* old = table;
+        size_t oldCapacity = capacity;
+
+        capacity *= 2;
+        table = new Bucket[capacity]();
+        for (size_t i = 0; i < oldCapacity; i++) {
+            if (old[i].queue != NULL)
+                table[findIndex(old[i].key)] = old[i];
+        }
+        delete[] old;
+    }
+
+    void eraseAt(size_t i) {
+        size_t mask = capacity - 1;
+        table[i].queue = NULL;
+        count--;
+
+        size_t j = i;
+        while (true) {
+            j = (j + 1) & mask;
+            if (table[j].queue == NULL) return;
+
+            size_t home = hash(table[j].key) & mask;
+            // Move j back into the hole unless its home lies in (i, j].
+            bool stays = (i <= j) ? (i < home && home <= j) : (i < home || home <= j);
+            if (!stays) {
+                table[i] = table[j];
+                table[j].queue = NULL;
+                i = j;
+            }
+        }
+    }
+
+    public:
+    WaitlistRegistry() {
+        capacity = 16;
+        count = 0;
+        table = new Bucket[capacity]();
+    }
+
+    ~WaitlistRegistry() {
+        clear();
+        delete[] table;
+    }
+
+    // Returns the queue for key, creating an empty one if needed.
+    WaitlistQueue* get(SlotKey key) {
+        {
+            shared_lock<shared_mutex> held(tableLock);
+            WaitlistQueue* queue = table[findIndex(key)].queue;
+            if (queue != NULL) return queue;
+        }
+
+        unique_lock<shared_mutex> held(tableLock);
+        if ((count + 1) * 4 > capacity * 3)
+            grow();
+
+        size_t i = findIndex(key);
+        if (table[i].queue == NULL) {
+            table[i].key = key;
+            table[i].queue = new WaitlistQueue();
+            count++;
+        }
+        return table[i].queue;
+    }
+
+    // Returns the queue for key, or NULL if nobody is waiting for it.
+    WaitlistQueue* find(SlotKey key) {
+        shared_lock<shared_mutex> held(tableLock);
+        return table[findIndex(key)].queue;
+    }
+
+    bool has(SlotKey key) {
+        WaitlistQueue* queue = find(key);
+        return queue != NULL && !queue->isEmpty();
+    }
+
+    // Removes the first booking waiting for key into booking. The queue is
+    // reclaimed once it is empty.
+    bool dequeue(SlotKey key, Booking& booking) {
+        unique_lock<shared_mutex> held(tableLock);
+        size_t i = findIndex(key);
+        if (table[i].queue == NULL) return false;
+
+        bool found = table[i].queue->deQueue(booking);
+        if (table[i].queue->isEmpty()) {
+            delete table[i].queue;
+            eraseAt(i);
+        }
+        return found;
+    }
+
+    // Calls visit(key, queue) for every slot with a queue, in table order.
+    template <class Visit>
+    void forEach(Visit visit) {
+        shared_lock<shared_mutex> held(tableLock);
+        for (size_t i = 0; i < capacity; i++) {
+            if (table[i].queue != NULL)
+                visit(table[i].key, table[i].queue);
+        }
+    }
+
+    void clear() {
+        unique_lock<shared_mutex> held(tableLock);
+        for (size_t i = 0; i < capacity; i++) {
+            if (table[i].queue != NULL) {
+                delete table[i].queue;
+                table[i].queue = NULL;
+            }
+        }
+        count = 0;
+    }
+
+    size_t size() {
+        shared_lock<shared_mutex> held(tableLock);
+        return count;
+    }
+
+    // Bytes held by the table, the queues and the queued bookings.
+    size_t memoryUsage() {
+        shared_lock<shared_mutex> held(tableLock);
+        size_t bytes = sizeof(*this) + capacity * sizeof(Bucket);
+        for (size_t i = 0; i < capacity; i++) {
+            if (table[i].queue == NULL) continue;
+
+            bytes += table[i].queue->memoryUsage();
+        }
+        return bytes;
+    }
+};
+
+#endif
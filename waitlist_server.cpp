@@ -0,0 +1,251 @@
+// Checks waitlist joins through the server. Clients join the waitlist of
+// one taken slot all at once, which the server runs under its engine lock
+// held shared, while another client keeps reading the waitlist. Every join
+// must be in the queue exactly once, each client's in the order it sent
+// them, and every read must show each client's joins in that order too.
+// Cancelling the slot must promote the front of the queue, and loading the
+// store again must give back the same queue: replayed from the W records
+// the joins wrote, in sync and in group mode, and from the queue written
+// out when the cancel compacts the journal.
+//
+// The checks work in their own directory and replace the bookings files
+// there.
+//
+//   waitlist_server [dir] [clients] [joins per client]
+#include <iostream>
+#include <string>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include "booking.hpp"
+#include "server.hpp"
+using namespace std;
+
+const char* const TEST_SOCKET = "waitlist_server.sock";
+const char* const SLOT_DATE = "261020";
+const int SLOT_HOUR = 9;
+const int SLOT_ROOM = 10;
+
+class Connection {
+    private:
+    int fd;
+    string input;
+
+    public:
+    Connection() {
+        fd = -1;
+    }
+
+    ~Connection() {
+        if (fd >= 0) ::close(fd);
+    }
+
+    bool open(const char* path) {
+        sockaddr_un addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        strncpy(addr.sun_path, path, sizeof(addr.sun_path) - 1);
+
+        fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        return fd >= 0 && connect(fd, (sockaddr*)&addr, sizeof(addr)) == 0;
+    }
+
+    // Sends one command and waits for its result line.
+    bool request(const string& command, string& reply) {
+        string line = command + "\n";
+        if (!writeAll(fd, line.data(), line.size())) return false;
+
+        size_t end;
+        char buffer[65536];
+        while ((end = input.find('\n')) == string::npos) {
+            int n = ::read(fd, buffer, sizeof(buffer));
+            if (n <= 0) return false;
+            input.append(buffer, n);
+        }
+        reply = input.substr(0, end);
+        input.erase(0, end + 1);
+        return true;
+    }
+};
+
+struct Entry {
+    int client;
+    int join;
+};
+
+// The "client<c>" lecturer and "<i>" course of every booking in a JSON
+// reply, in order. Other bookings are skipped.
+vector<Entry> ParseEntries(const string& reply) {
+    vector<Entry> entries;
+    const string lecturer = "\"lecturer\":\"client";
+    const string course = "\"course\":\"";
+    size_t at = 0;
+    while ((at = reply.find(lecturer, at)) != string::npos) {
+        at += lecturer.size();
+        Entry e;
+        e.client = atoi(reply.c_str() + at);
+        at = reply.find(course, at) + course.size();
+        e.join = atoi(reply.c_str() + at);
+        entries.push_back(e);
+    }
+    return entries;
+}
+
+// True if each client's entries are its joins 0, 1, 2, ... in order, with
+// none missing before the last one shown.
+bool InClientOrder(const vector<Entry>& entries, int clients) {
+    vector<int> next(clients, 0);
+    for (size_t i = 0; i < entries.size(); i++) {
+        const Entry& e = entries[i];
+        if (e.client < 0 || e.client >= clients || e.join != next[e.client]) return false;
+        next[e.client]++;
+    }
+    return true;
+}
+
+string SlotFields() {
+    return string(SLOT_DATE) + "," + to_string(SLOT_HOUR);
+}
+
+bool Expect(bool condition, const string& what) {
+    if (!condition) cerr << "FAILED: " << what << "\n";
+    return condition;
+}
+
+void RemoveBookingFiles() {
+    remove(BOOKINGS_FILE);
+    remove(JOURNAL_FILE);
+    remove(JOURNAL_OLD_FILE);
+}
+
+bool RunMode(Durability mode, int compactThreshold, const char* name, int clients, int joins) {
+    RemoveBookingFiles();
+    writeFileAtomic(BOOKINGS_FILE, SlotFields() + "," + to_string(SLOT_ROOM) + ",Owner,C0\n");
+
+    bool ok = true;
+    BookingStore store;
+    journal.setDurability(mode);
+    journal.compactThreshold = compactThreshold;
+    if (!Expect(LoadFromFile(store), string(name) + ": load")) return false;
+
+    BookingServer server(store);
+    string error;
+    if (!Expect(server.listen(TEST_SOCKET, error), string(name) + ": listen: " + error)) return false;
+    thread serving([&]() { server.run(); });
+
+    string waitlistCommand = "waitlist," + SlotFields() + "," + to_string(SLOT_ROOM);
+    atomic<int> ready(0);
+    atomic<int> done(0);
+    atomic<int> failures(0);
+    atomic<int> misreads(0);
+    vector<thread> threads;
+
+    for (int c = 0; c < clients; c++) {
+        threads.push_back(thread([&, c]() {
+            Connection conn;
+            bool connected = conn.open(TEST_SOCKET);
+            ready++;
+            while (ready < clients + 1) this_thread::yield();
+
+            string reply;
+            for (int i = 0; connected && i < joins; i++) {
+                string command = "book," + SlotFields() + ",1," + to_string(SLOT_ROOM) + ",client"
+                               + to_string(c) + "," + to_string(i) + ",waitlist";
+                if (!conn.request(command, reply) || reply.find("\"status\":\"waitlisted\"") == string::npos)
+                    failures++;
+            }
+            if (!connected) failures++;
+            done++;
+        }));
+    }
+    threads.push_back(thread([&]() {
+        Connection conn;
+        bool connected = conn.open(TEST_SOCKET);
+        ready++;
+        while (ready < clients + 1) this_thread::yield();
+
+        string reply;
+        while (connected && done < clients) {
+            if (!conn.request(waitlistCommand, reply) || !InClientOrder(ParseEntries(reply), clients))
+                misreads++;
+        }
+    }));
+    for (size_t i = 0; i < threads.size(); i++)
+        threads[i].join();
+
+    ok &= Expect(failures == 0, string(name) + ": every join answered waitlisted");
+    ok &= Expect(misreads == 0, string(name) + ": concurrent reads show each client's joins in order");
+
+    Connection conn;
+    string reply;
+    ok &= Expect(conn.open(TEST_SOCKET) && conn.request(waitlistCommand, reply), string(name) + ": read waitlist");
+    vector<Entry> queued = ParseEntries(reply);
+    ok &= Expect((int)queued.size() == clients * joins, string(name) + ": no join lost or doubled ("
+                 + to_string(queued.size()) + " of " + to_string(clients * joins) + " queued)");
+    ok &= Expect(InClientOrder(queued, clients), string(name) + ": each client's joins in order");
+
+    ok &= Expect(conn.request("cancel," + SlotFields() + ",1," + to_string(SLOT_ROOM), reply),
+                 string(name) + ": cancel");
+    size_t promotedAt = reply.find("\"promoted\"");
+    vector<Entry> promoted = ParseEntries(promotedAt != string::npos ? reply.substr(promotedAt) : "");
+    ok &= Expect(!queued.empty() && promoted.size() == 1 && promoted[0].client == queued[0].client &&
+                 promoted[0].join == queued[0].join, string(name) + ": front of the queue promoted");
+    ok &= Expect(conn.request(waitlistCommand, reply), string(name) + ": read waitlist after cancel");
+    vector<Entry> left = ParseEntries(reply);
+    ok &= Expect((int)left.size() == clients * joins - 1, string(name) + ": the rest still queued");
+
+    raise(SIGTERM);
+    serving.join();
+    journal.close();
+    store.clear();
+
+    ifstream in(JOURNAL_FILE);
+    string first;
+    getline(in, first);
+    ok &= Expect((first == "R") == (compactThreshold == 1), string(name) + ": journal compacted only when asked");
+
+    ok &= Expect(LoadFromFile(store), string(name) + ": load again");
+    vector<Entry> replayed;
+    SlotKey key = 0;
+    makeKey(SLOT_DATE, SLOT_HOUR, to_string(SLOT_ROOM), key);
+    WaitlistRegistry* waitlists = WaitlistsFor(store, slotDay(key));
+    WaitlistQueue* queue = waitlists != NULL ? waitlists->find(key) : NULL;
+    if (queue != NULL) {
+        queue->forEach([&](const Booking& b) {
+            Entry e;
+            e.client = atoi(Names().name(b.lecturer).c_str() + 6);
+            e.join = atoi(Names().name(b.course).c_str());
+            replayed.push_back(e);
+        });
+    }
+    bool same = replayed.size() == left.size();
+    for (size_t i = 0; same && i < left.size(); i++)
+        same = replayed[i].client == left[i].client && replayed[i].join == left[i].join;
+    ok &= Expect(same, string(name) + ": reload gives back the queue in order");
+
+    journal.close();
+    store.clear();
+    RemoveBookingFiles();
+    return ok;
+}
+
+int main(int argc, char* argv[]) {
+    string dir = argc > 1 ? argv[1] : "waitlist_server.tmp";
+    int clients = argc > 2 ? atoi(argv[2]) : 8;
+    int joins = argc > 3 ? atoi(argv[3]) : 150;
+    mkdir(dir.c_str(), 0755);
+    if (chdir(dir.c_str()) != 0) {
+        cerr << dir << ": cannot use as test directory\n";
+        return 1;
+    }
+
+    bool ok = RunMode(DURABILITY_SYNC, 1 << 30, "sync", clients, joins);
+    ok &= RunMode(DURABILITY_GROUP, 1 << 30, "group", clients, joins);
+    ok &= RunMode(DURABILITY_GROUP, 1, "group, compacting", clients, joins);
+
+    cout << (ok ? "passed" : "FAILED") << " (" << clients << " clients x " << joins << " joins)\n";
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,140 @@
+// Stress test for the waitlist queues. Producer threads enqueue numbered
+// bookings while one consumer dequeues them. Every booking must come out
+// exactly once, each producer's bookings must come out in the order it
+// queued them, and the size counter must agree with what is left. Each
+// enqueue also records its booking in a shared log, as joins write the
+// journal, and the log must list the bookings in the order they came out.
+//
+// Rounds alternate between a consumer running alongside the producers and
+// one draining after them, and between ConcurrentWaitlistQueue and the
+// WaitlistQueue built on it.
+//
+//   waitlist_stress [producers] [bookings per producer] [rounds]
+#include <iostream>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <cstdlib>
+#include "queue.hpp"
+using namespace std;
+
+template <class Q>
+bool RunRound(int producers, int perProducer, bool concurrentConsumer) {
+    Q queue;
+    atomic<int> started(0);
+    atomic<bool> producing(true);
+    vector<thread> threads;
+    mutex logLock;
+    vector<Booking> log;
+
+    for (int p = 0; p < producers; p++) {
+        threads.push_back(thread([&, p]() {
+            started++;
+            while (started < producers) this_thread::yield();
+
+            for (int i = 0; i < perProducer; i++) {
+                Booking b;
+                b.date = 0;
+                b.hour = 0;
+                b.room = 1;
+                b.lecturer = p;
+                b.course = i;
+                queue.enQueue(b, [&](const Booking& queued) {
+                    lock_guard<mutex> held(logLock);
+                    log.push_back(queued);
+                });
+            }
+        }));
+    }
+
+    long long total = (long long)producers * perProducer;
+    vector<int> nextSeq(producers, 0);
+    long long received = 0;
+    long long misordered = 0;
+    bool ok = true;
+
+    auto take = [&](const Booking& b) {
+        if (b.lecturer < 0 || b.lecturer >= producers) {
+            cerr << "unknown producer " << b.lecturer << "\n";
+            ok = false;
+        } else if (b.course != nextSeq[b.lecturer]) {
+            cerr << "producer " << b.lecturer << ": expected " << nextSeq[b.lecturer]
+                 << ", got " << b.course << "\n";
+            ok = false;
+            nextSeq[b.lecturer] = b.course + 1;
+        } else {
+            nextSeq[b.lecturer]++;
+        }
+
+        // A booking only comes out once its record has run, so the log is
+        // always at least this long.
+        lock_guard<mutex> held(logLock);
+        if (received >= (long long)log.size() || log[received].lecturer != b.lecturer ||
+            log[received].course != b.course)
+            misordered++;
+        received++;
+    };
+
+    Booking b;
+    if (concurrentConsumer) {
+        thread consumer([&]() {
+            while (producing || !queue.isEmpty()) {
+                if (queue.deQueue(b))
+                    take(b);
+                else
+                    this_thread::yield();
+            }
+        });
+        for (size_t i = 0; i < threads.size(); i++)
+            threads[i].join();
+        producing = false;
+        consumer.join();
+    } else {
+        for (size_t i = 0; i < threads.size(); i++)
+            threads[i].join();
+        if (queue.getSize() != total) {
+            cerr << "size " << queue.getSize() << " after " << total << " enqueues\n";
+            ok = false;
+        }
+        while (queue.deQueue(b))
+            take(b);
+    }
+
+    if (received != total) {
+        cerr << "received " << received << " of " << total << "\n";
+        ok = false;
+    }
+    if (misordered > 0 || (long long)log.size() != total) {
+        cerr << misordered << " bookings out of log order (" << log.size() << " logged)\n";
+        ok = false;
+    }
+    if (queue.getSize() != 0 || !queue.isEmpty() || queue.deQueue(b)) {
+        cerr << "queue not empty after draining (size " << queue.getSize() << ")\n";
+        ok = false;
+    }
+    return ok;
+}
+
+int main(int argc, char* argv[]) {
+    int producers = argc > 1 ? atoi(argv[1]) : 8;
+    int perProducer = argc > 2 ? atoi(argv[2]) : 100000;
+    int rounds = argc > 3 ? atoi(argv[3]) : 10;
+
+    int failed = 0;
+    for (int r = 0; r < rounds; r++) {
+        bool concurrent = r % 2 == 0;
+        bool slotQueue = r % 4 >= 2;
+        bool ok = slotQueue ? RunRound<WaitlistQueue>(producers, perProducer, concurrent)
+                            : RunRound<ConcurrentWaitlistQueue>(producers, perProducer, concurrent);
+        if (!ok) {
+            cerr << "round " << r << (slotQueue ? " WaitlistQueue" : " ConcurrentWaitlistQueue")
+                 << (concurrent ? " (concurrent consumer)" : " (drain after)") << " FAILED\n";
+            failed++;
+        }
+    }
+
+    cout << rounds - failed << "/" << rounds << " rounds passed ("
+         << producers << " producers x " << perProducer << " bookings)\n";
+    return failed == 0 ? 0 : 1;
+}